@@ -0,0 +1,486 @@
+#include "batch.hpp"
+#include "board.hpp"
+#include "search.hpp"
+#include "stats.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Micro-benchmarks of the board hot paths. Every operation is run over the
+// same corpus of positions, the median of the repetitions is compared with
+// the stored baseline and the exit code is non-zero on a regression. Legal
+// move counting is also timed over a batch of positions with the SoA kernels
+// of `batch.hpp`, whose counts must agree with the single-board path.
+//
+// usage: bench [--baseline <path>] [--update] [--tolerance <fraction>]
+//              [--repetitions <count>]
+
+#ifdef CHESS_STATS
+
+// the instrumented build replaces operator new already
+unsigned long long allocations_count() {
+  return chess::stats::snapshot()[chess::stats::Counter::ALLOCATIONS];
+}
+
+#else
+
+namespace {
+
+std::atomic<unsigned long long> allocations = 0;
+
+} // namespace
+
+unsigned long long allocations_count() { return allocations.load(); }
+
+// not inlined, otherwise gcc pairs the inlined `malloc` and `free` with
+// library `new` and `delete` and warns about a mismatch
+[[gnu::noinline]] void *operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void *ptr) noexcept { std::free(ptr); }
+[[gnu::noinline]] void operator delete(void *ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+#endif // CHESS_STATS
+
+namespace chess {
+
+// Reaches the private parts of `Board` that are measured on their own.
+class Bench {
+public:
+  static void fill_checked_squares(Board &board) {
+    board.fill_checked_squares();
+  }
+
+  static void parse_board_from_fen(Board &board, std::string_view fen) {
+    board.m_squares.fill(pieces::NONE);
+    board.m_halfmoves_50rule_count = 0;
+    board.m_moves_count = 0;
+    board.parse_board_from_fen(fen);
+  }
+
+  // the moves of the position are generated again on the next call
+  static void invalidate_legal_moves(const Board &board) {
+    board.m_legal_moves[board.m_hash % board.m_legal_moves.size()].valid =
+        false;
+  }
+};
+
+} // namespace chess
+
+namespace {
+
+constexpr std::string_view corpus[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q2/PPPBBPpP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "4k3/8/8/8/8/8/8/4K2R w K - 0 1",
+    "8/8/1k6/8/2pP4/8/5K2/8 b - d3 0 1",
+};
+
+constexpr int plies_per_position = 8;
+// the corpus and the positions along its lines, repeated to fill the batch
+constexpr std::size_t batch_size = 1024;
+
+struct Result {
+  std::string name;
+  double ns_per_op = 0;
+  double allocs_per_op = 0;
+};
+
+// Accumulates time and allocations of the measured parts of a batch only,
+// so the setup around them (copies, history bookkeeping) is not counted.
+class Timer {
+public:
+  void start() {
+    m_allocs -= allocations_count();
+    m_start = std::chrono::steady_clock::now();
+  }
+
+  void stop() {
+    m_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - m_start)
+                .count();
+    m_allocs += allocations_count();
+  }
+
+  long long ns() const { return m_ns; }
+  unsigned long long allocs() const { return m_allocs; }
+
+private:
+  std::chrono::steady_clock::time_point m_start;
+  long long m_ns = 0;
+  unsigned long long m_allocs = 0;
+};
+
+// `run` performs a batch of operations and returns how many it did.
+Result measure(std::string name, int repetitions,
+               const std::function<long long(Timer &)> &run) {
+  constexpr int warmup = 3;
+  for (int i = 0; i < warmup; ++i) {
+    Timer timer;
+    run(timer);
+  }
+
+  std::vector<double> ns_per_op;
+  double allocs_per_op = 0;
+  for (int i = 0; i < repetitions; ++i) {
+    Timer timer;
+    const long long ops = run(timer);
+    ns_per_op.push_back(static_cast<double>(timer.ns()) / ops);
+    allocs_per_op = static_cast<double>(timer.allocs()) / ops;
+  }
+
+  std::nth_element(ns_per_op.begin(), ns_per_op.begin() + repetitions / 2,
+                   ns_per_op.end());
+  return {std::move(name), ns_per_op[repetitions / 2], allocs_per_op};
+}
+
+// Plays a fixed line from every corpus position, so make and unmake can be
+// timed separately over the same moves.
+std::vector<std::vector<chess::Move>> lines(std::vector<chess::Board> &boards) {
+  std::vector<std::vector<chess::Move>> result;
+  for (auto &board : boards) {
+    board.history().push(board);
+    auto &line = result.emplace_back();
+    for (int ply = 0; ply < plies_per_position && board.has_legal_move();
+         ++ply) {
+      const auto &moves = board.legal_moves();
+      const auto move = moves[(ply * 7) % moves.size()];
+      line.push_back(move);
+      board.make_move(move.from, move.to);
+    }
+    for (std::size_t ply = 0; ply < line.size(); ++ply) {
+      board.unmake_move();
+    }
+    board.history().pop();
+  }
+  return result;
+}
+
+// Every position reached along the lines, repeated up to `batch_size`.
+std::vector<chess::Board>
+line_positions(const std::vector<chess::Board> &boards,
+               const std::vector<std::vector<chess::Move>> &moves) {
+  std::vector<chess::Board> unique;
+  for (std::size_t i = 0; i < boards.size(); ++i) {
+    auto board = boards[i];
+    board.history().push(board);
+    unique.push_back(board);
+    for (const auto move : moves[i]) {
+      board.make_move(move.from, move.to);
+      unique.push_back(board);
+    }
+    for (std::size_t ply = 0; ply <= moves[i].size(); ++ply) {
+      board.history().pop();
+    }
+  }
+
+  std::vector<chess::Board> result;
+  while (result.size() < batch_size) {
+    result.push_back(unique[result.size() % unique.size()]);
+  }
+  return result;
+}
+
+// The batch kernels have to agree with `Board::legal_moves`, otherwise
+// their timings mean nothing.
+bool check_batch(std::vector<chess::Board> &positions,
+                 const chess::BoardBatch &batch) {
+  chess::BatchResult result, scalar;
+  chess::analyse_batch(batch, result);
+  chess::analyse_batch_scalar(batch, scalar);
+  bool ok = true;
+  for (std::size_t i = 0; i < positions.size(); ++i) {
+    const auto expected = positions[i].legal_moves().size();
+    const bool checked = positions[i].king_checked();
+    if (result.legal_moves[i] != expected ||
+        scalar.legal_moves[i] != expected ||
+        static_cast<bool>(result.in_check[i]) != checked ||
+        static_cast<bool>(scalar.in_check[i]) != checked) {
+      std::fprintf(stderr,
+                   "batch mismatch in %s: %d moves, batch %d/%d, "
+                   "check %d, batch %d/%d\n",
+                   positions[i].to_fen().c_str(), static_cast<int>(expected),
+                   result.legal_moves[i], scalar.legal_moves[i], checked,
+                   static_cast<int>(result.in_check[i]),
+                   static_cast<int>(scalar.in_check[i]));
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+std::vector<Result> run_benchmarks(int repetitions, bool &batch_ok) {
+  std::vector<chess::Board> boards;
+  for (const auto fen : corpus) {
+    boards.emplace_back(fen);
+  }
+  // constructors push the boards, every batch below keeps history balanced
+  auto &history = boards.front().history();
+  while (!history.empty()) {
+    history.pop();
+  }
+  const auto moves = lines(boards);
+  auto positions = line_positions(boards, moves);
+  chess::BoardBatch batch;
+  for (const auto &position : positions) {
+    batch.push_back(position);
+  }
+  batch_ok = check_batch(positions, batch);
+
+  std::vector<Result> results;
+
+  results.push_back(measure("make_move", repetitions, [&](Timer &timer) {
+    long long ops = 0;
+    for (std::size_t i = 0; i < boards.size(); ++i) {
+      auto board = boards[i];
+      history.push(board);
+      timer.start();
+      for (const auto move : moves[i]) {
+        board.make_move(move.from, move.to);
+      }
+      timer.stop();
+      ops += moves[i].size();
+      for (std::size_t ply = 0; ply <= moves[i].size(); ++ply) {
+        history.pop();
+      }
+    }
+    return ops;
+  }));
+
+  results.push_back(measure("unmake_move", repetitions, [&](Timer &timer) {
+    long long ops = 0;
+    for (std::size_t i = 0; i < boards.size(); ++i) {
+      auto board = boards[i];
+      history.push(board);
+      for (const auto move : moves[i]) {
+        board.make_move(move.from, move.to);
+      }
+      timer.start();
+      for (std::size_t ply = 0; ply < moves[i].size(); ++ply) {
+        board.unmake_move();
+      }
+      timer.stop();
+      ops += moves[i].size();
+      history.pop();
+    }
+    return ops;
+  }));
+
+  results.push_back(measure("generate_moves", repetitions, [&](Timer &timer) {
+    long long ops = 0;
+    for (auto &board : boards) {
+      history.push(board);
+      chess::Bench::invalidate_legal_moves(board);
+      timer.start();
+      for (int from = 0; from < 64; ++from) {
+        board.generate_moves(from);
+      }
+      timer.stop();
+      history.pop();
+      ++ops;
+    }
+    return ops;
+  }));
+
+  results.push_back(
+      measure("fill_checked_squares", repetitions, [&](Timer &timer) {
+        long long ops = 0;
+        timer.start();
+        for (auto &board : boards) {
+          chess::Bench::fill_checked_squares(board);
+          ++ops;
+        }
+        timer.stop();
+        return ops;
+      }));
+
+  results.push_back(measure("to_fen", repetitions, [&](Timer &timer) {
+    long long ops = 0;
+    timer.start();
+    for (const auto &board : boards) {
+      board.to_fen();
+      ++ops;
+    }
+    timer.stop();
+    return ops;
+  }));
+
+  chess::Board parsed = boards.front();
+  results.push_back(
+      measure("parse_board_from_fen", repetitions, [&](Timer &timer) {
+        long long ops = 0;
+        timer.start();
+        for (const auto fen : corpus) {
+          chess::Bench::parse_board_from_fen(parsed, fen);
+          ++ops;
+        }
+        timer.stop();
+        return ops;
+      }));
+
+  // pawn structures come from the pawn table after the first repetition
+  results.push_back(measure("evaluate", repetitions, [&](Timer &timer) {
+    timer.start();
+    for (const auto &position : positions) {
+      chess::Search::evaluate(position);
+    }
+    timer.stop();
+    return static_cast<long long>(positions.size());
+  }));
+
+  // the same positions one board at a time and as a batch; the positions
+  // repeat, so every one is invalidated right before it is generated
+  results.push_back(
+      measure("legal_moves_single", repetitions, [&](Timer &timer) {
+        timer.start();
+        for (auto &position : positions) {
+          chess::Bench::invalidate_legal_moves(position);
+          position.legal_moves();
+        }
+        timer.stop();
+        return static_cast<long long>(positions.size());
+      }));
+
+  chess::BatchResult batch_result;
+  results.push_back(
+      measure("legal_moves_batch", repetitions, [&](Timer &timer) {
+        timer.start();
+        chess::analyse_batch(batch, batch_result);
+        timer.stop();
+        return static_cast<long long>(batch.size());
+      }));
+
+  results.push_back(
+      measure("legal_moves_batch_scalar", repetitions, [&](Timer &timer) {
+        timer.start();
+        chess::analyse_batch_scalar(batch, batch_result);
+        timer.stop();
+        return static_cast<long long>(batch.size());
+      }));
+
+  return results;
+}
+
+// The baseline is the flat file written by `--update`, so looking up the
+// keys is all the parsing it needs.
+bool read_baseline(const std::string &text, const std::string &name,
+                   Result &result) {
+  const auto entry = text.find('"' + name + '"');
+  if (entry == std::string::npos) {
+    return false;
+  }
+  const auto value = [&](std::string_view key) {
+    const auto pos = text.find(key, entry);
+    return pos == std::string::npos
+               ? -1.0
+               : std::strtod(text.c_str() + text.find(':', pos) + 1, nullptr);
+  };
+  result.name = name;
+  result.ns_per_op = value("\"ns_per_op\"");
+  result.allocs_per_op = value("\"allocs_per_op\"");
+  return result.ns_per_op >= 0 && result.allocs_per_op >= 0;
+}
+
+void write_baseline(const std::string &path,
+                    const std::vector<Result> &results) {
+  std::ofstream out(path);
+  out << "{\n";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    out << "  \"" << results[i].name
+        << "\": {\"ns_per_op\": " << results[i].ns_per_op
+        << ", \"allocs_per_op\": " << results[i].allocs_per_op << "}"
+        << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  out << "}\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  SetTraceLogLevel(LOG_WARNING);
+
+  std::string baseline_path = "../bench/baseline.json";
+  bool update = false;
+  double tolerance = 0.25;
+  int repetitions = 15;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if (arg == "--update") {
+      update = true;
+    } else if (arg == "--baseline" && i + 1 < argc) {
+      baseline_path = argv[++i];
+    } else if (arg == "--tolerance" && i + 1 < argc) {
+      tolerance = std::atof(argv[++i]);
+    } else if (arg == "--repetitions" && i + 1 < argc) {
+      repetitions = std::max(1, std::atoi(argv[++i]));
+    } else {
+      std::fprintf(stderr,
+                   "usage: %s [--baseline <path>] [--update] "
+                   "[--tolerance <fraction>] [--repetitions <count>]\n",
+                   argv[0]);
+      return 2;
+    }
+  }
+
+  bool batch_ok = true;
+  const auto results = run_benchmarks(repetitions, batch_ok);
+
+  if (update) {
+    write_baseline(baseline_path, results);
+    std::printf("baseline written to %s\n", baseline_path.c_str());
+  }
+
+  std::ostringstream text;
+  text << std::ifstream(baseline_path).rdbuf();
+
+  bool regressed = false;
+  std::printf("%-24s %12s %10s %12s %10s\n", "operation", "ns/op",
+              "allocs/op", "base ns/op", "status");
+  for (const auto &result : results) {
+    Result base;
+    const char *status = "no baseline";
+    if (read_baseline(text.str(), result.name, base)) {
+      const bool slower = result.ns_per_op > base.ns_per_op * (1 + tolerance);
+      const bool allocates =
+          result.allocs_per_op > base.allocs_per_op * (1 + tolerance) + 0.5;
+      status = slower || allocates ? "REGRESSED" : "ok";
+      regressed = regressed || slower || allocates;
+    }
+    std::printf("%-24s %12.1f %10.2f %12.1f %10s\n", result.name.c_str(),
+                result.ns_per_op, result.allocs_per_op, base.ns_per_op,
+                status);
+  }
+
+  const auto find = [&](std::string_view name) {
+    return std::find_if(results.begin(), results.end(), [&](const Result &r) {
+             return r.name == name;
+           })->ns_per_op;
+  };
+  std::printf("batch of %zu positions: %.1fx the single-board throughput "
+              "(%.1fx without SIMD)\n",
+              batch_size,
+              find("legal_moves_single") / find("legal_moves_batch"),
+              find("legal_moves_single") / find("legal_moves_batch_scalar"));
+
+  return regressed || !batch_ok ? 1 : 0;
+}
@@ -0,0 +1,203 @@
+#include "analysis_cache.hpp"
+#include "stats.hpp"
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+using chess::Bound;
+using chess::CacheEntry;
+
+constexpr std::uint64_t magic = 0x3143415353454843ull; // "CHESSAC1"
+constexpr std::uint32_t version = 2;
+constexpr std::size_t header_bytes = 64;
+constexpr std::size_t bucket_bytes = 64;
+
+struct Header {
+  std::uint64_t magic;
+  std::uint32_t version;
+  std::uint32_t bucket_bytes;
+  std::uint64_t buckets;
+  std::uint32_t evaluation; // of the search that wrote the results
+};
+
+// Layout of a data word: from and to squares in bits 0-11, the score in
+// 12-27, depth in 28-35 and bound in 36-37.
+std::uint64_t pack(const CacheEntry &entry) {
+  const auto score = static_cast<std::uint16_t>(entry.score);
+  const auto depth = static_cast<std::uint8_t>(std::clamp(entry.depth, 0, 255));
+  return std::uint64_t{entry.best_move.from} |
+         std::uint64_t{entry.best_move.to} << 6 | std::uint64_t{score} << 12 |
+         std::uint64_t{depth} << 28 |
+         static_cast<std::uint64_t>(entry.bound) << 36;
+}
+
+CacheEntry unpack(std::uint64_t data) {
+  CacheEntry entry;
+  entry.best_move.from = data & 63;
+  entry.best_move.to = data >> 6 & 63;
+  entry.score = static_cast<std::int16_t>(data >> 12 & 0xffff);
+  entry.depth = data >> 28 & 0xff;
+  entry.bound = static_cast<Bound>(data >> 36 & 3);
+  return entry;
+}
+
+// Whether a result was ever written to the slot. A torn slot can not be
+// told from a whole one here, only a probe for its key rejects it.
+bool used(std::uint64_t data) {
+  return static_cast<Bound>(data >> 36 & 3) != Bound::NONE;
+}
+
+std::uint64_t load(std::uint64_t &word) {
+  return std::atomic_ref(word).load(std::memory_order_relaxed);
+}
+
+void save(std::uint64_t &word, std::uint64_t value) {
+  std::atomic_ref(word).store(value, std::memory_order_relaxed);
+}
+
+} // namespace
+
+std::unique_ptr<chess::AnalysisCache>
+chess::AnalysisCache::open(const std::string &path, std::uint32_t evaluation,
+                           std::size_t max_bytes) {
+  const std::size_t buckets = std::bit_floor(std::max<std::size_t>(
+      1, (std::max(max_bytes, header_bytes) - header_bytes) / bucket_bytes));
+  const std::size_t bytes = header_bytes + buckets * bucket_bytes;
+
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd == -1) {
+    return nullptr;
+  }
+  // another process may be setting up the same file
+  ::flock(fd, LOCK_EX);
+
+  struct stat status {};
+  Header header{};
+  const bool reusable =
+      ::fstat(fd, &status) == 0 && status.st_size == bytes &&
+      ::pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+      header.magic == magic && header.version == version &&
+      header.bucket_bytes == bucket_bytes && header.buckets == buckets &&
+      header.evaluation == evaluation;
+  // Another process may have a file of another format or size mapped, and
+  // would get SIGBUS if it was cut short under it. A new file is set up
+  // next to it and takes its place, the old one lives on until unmapped.
+  // Processes replacing the same file at once each set up their own.
+  std::string fresh_path = path + ".XXXXXX";
+  const bool replace = !reusable && status.st_size != 0;
+  if (replace) {
+    ::flock(fd, LOCK_UN);
+    ::close(fd);
+    fd = ::mkostemp(fresh_path.data(), O_CLOEXEC);
+    if (fd == -1) {
+      return nullptr;
+    }
+    ::fchmod(fd, 0644);
+  }
+  if (!reusable && ::ftruncate(fd, bytes) != 0) {
+    ::close(fd);
+    if (replace) {
+      ::unlink(fresh_path.c_str());
+    }
+    return nullptr;
+  }
+
+  void *mapping =
+      ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping != MAP_FAILED && !reusable) {
+    // the magic goes last, a file cut short by a crash is started over
+    auto &fresh = *static_cast<Header *>(mapping);
+    fresh.version = version;
+    fresh.bucket_bytes = bucket_bytes;
+    fresh.buckets = buckets;
+    fresh.evaluation = evaluation;
+    std::atomic_ref(fresh.magic).store(magic, std::memory_order_release);
+  }
+  // the mapping keeps the lock alive past close(), it has to be let go
+  ::flock(fd, LOCK_UN);
+  ::close(fd);
+  if (replace && (mapping == MAP_FAILED ||
+                  std::rename(fresh_path.c_str(), path.c_str()) != 0)) {
+    ::unlink(fresh_path.c_str());
+    if (mapping != MAP_FAILED) {
+      ::munmap(mapping, bytes);
+    }
+    return nullptr;
+  }
+  if (mapping == MAP_FAILED) {
+    return nullptr;
+  }
+  return std::unique_ptr<AnalysisCache>(
+      new AnalysisCache(mapping, bytes, buckets));
+}
+
+chess::AnalysisCache::AnalysisCache(void *mapping, std::size_t bytes,
+                                    std::size_t buckets)
+    : m_mapping(mapping), m_bytes(bytes), m_buckets(buckets),
+      m_slots(reinterpret_cast<Slot *>(static_cast<char *>(mapping) +
+                                       header_bytes)) {
+  static_assert(sizeof(Slot) * BUCKET_SIZE == bucket_bytes);
+  static_assert(sizeof(Header) <= header_bytes);
+}
+
+chess::AnalysisCache::~AnalysisCache() { ::munmap(m_mapping, m_bytes); }
+
+std::optional<chess::CacheEntry>
+chess::AnalysisCache::probe(std::uint64_t key) const {
+  STATS_INCREMENT(ANALYSIS_CACHE_PROBES);
+  Slot *bucket = m_slots + (key & (m_buckets - 1)) * BUCKET_SIZE;
+  for (std::size_t i = 0; i < BUCKET_SIZE; ++i) {
+    const auto data = load(bucket[i].data);
+    const auto check = load(bucket[i].check);
+    // a torn slot pairs the words of two writes and matches no key
+    if ((data ^ check) == key && used(data)) {
+      STATS_INCREMENT(ANALYSIS_CACHE_HITS);
+      return unpack(data);
+    }
+  }
+  return std::nullopt;
+}
+
+void chess::AnalysisCache::store(std::uint64_t key, const CacheEntry &entry) {
+  Slot *bucket = m_slots + (key & (m_buckets - 1)) * BUCKET_SIZE;
+  Slot *victim = nullptr;
+  int victim_depth = 256;
+  for (std::size_t i = 0; i < BUCKET_SIZE; ++i) {
+    const auto data = load(bucket[i].data);
+    const auto check = load(bucket[i].check);
+    if (!used(data)) {
+      victim = &bucket[i];
+      victim_depth = -1;
+    } else if ((data ^ check) == key) {
+      if (unpack(data).depth > entry.depth) {
+        return;
+      }
+      victim = &bucket[i];
+      break;
+    } else if (unpack(data).depth < victim_depth) {
+      victim = &bucket[i];
+      victim_depth = unpack(data).depth;
+    }
+  }
+
+  const auto data = pack(entry);
+  save(victim->data, data);
+  save(victim->check, key ^ data);
+}
+
+std::size_t chess::AnalysisCache::occupied() const {
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < capacity(); ++i) {
+    count += used(load(m_slots[i].data));
+  }
+  return count;
+}
@@ -0,0 +1,77 @@
+#ifndef ANALYSIS_CACHE_HPP_
+#define ANALYSIS_CACHE_HPP_
+
+#include "move.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace chess {
+
+// Which side of the true score a search result is.
+enum class Bound : std::uint8_t { NONE, UPPER, LOWER, EXACT };
+
+struct CacheEntry {
+  Move best_move;
+  int score = 0;
+  int depth = 0;
+  Bound bound = Bound::NONE;
+};
+
+// Search results keyed by `Board::hash`, kept in a memory-mapped file so
+// later sessions start from the work of earlier ones. Several threads and
+// processes may share one file. A slot is two 64-bit words written
+// separately, the second being the key xored with the first. A slot torn
+// by a concurrent writer or a crash holds the words of two writes, so it
+// matches no key (but by a 1 in 2^64 chance) and is never returned by a
+// probe; it keeps its place until a store replaces it. The file never
+// grows past the size it was opened with; when a bucket is full the
+// shallowest result in it gives way.
+class AnalysisCache {
+public:
+  static constexpr std::size_t DEFAULT_BYTES = std::size_t{64} << 20;
+
+  // Maps the cache at `path`, creating it as needed. Results are only kept
+  // for searches of the same `evaluation` version, a file written with
+  // another version, format or size is replaced by an empty one, never
+  // changed in place. Returns nullptr when the file cannot be opened or
+  // mapped.
+  static std::unique_ptr<AnalysisCache>
+  open(const std::string &path, std::uint32_t evaluation,
+       std::size_t max_bytes = DEFAULT_BYTES);
+
+  ~AnalysisCache();
+  AnalysisCache(const AnalysisCache &other) = delete;
+  AnalysisCache &operator=(const AnalysisCache &other) = delete;
+  AnalysisCache(AnalysisCache &&other) = delete;
+  AnalysisCache &operator=(AnalysisCache &&other) = delete;
+
+  std::optional<CacheEntry> probe(std::uint64_t key) const;
+  // keeps a deeper result of the same position over a shallower one
+  void store(std::uint64_t key, const CacheEntry &entry);
+
+  std::size_t capacity() const { return m_buckets * BUCKET_SIZE; }
+  // slots holding a result, counted by walking the whole table
+  std::size_t occupied() const;
+
+private:
+  static constexpr std::size_t BUCKET_SIZE = 4;
+
+  struct Slot {
+    std::uint64_t data;
+    std::uint64_t check; // key ^ data
+  };
+
+  AnalysisCache(void *mapping, std::size_t bytes, std::size_t buckets);
+
+  void *m_mapping;
+  std::size_t m_bytes;
+  std::size_t m_buckets;
+  Slot *m_slots;
+};
+
+} // namespace chess
+
+#endif // ANALYSIS_CACHE_HPP_
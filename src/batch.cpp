@@ -0,0 +1,98 @@
+#include "batch.hpp"
+#include "batch_kernels.hpp"
+#include <bit>
+
+namespace {
+
+// one position per lane, the portable fallback and the tail of a batch
+struct Scalar {
+  static constexpr int width = 1;
+  std::uint64_t value = 0;
+
+  Scalar() = default;
+  explicit Scalar(std::uint64_t v) : value(v) {}
+
+  static Scalar load(const std::uint64_t *p) { return Scalar(*p); }
+  void store(std::uint64_t *p) const { *p = value; }
+
+  template <int N> Scalar shl() const { return Scalar(value << N); }
+  template <int N> Scalar shr() const { return Scalar(value >> N); }
+
+  Scalar nonzero() const { return Scalar(value != 0 ? ~0ull : 0); }
+  Scalar popcount() const {
+    return Scalar(static_cast<std::uint64_t>(std::popcount(value)));
+  }
+
+  Scalar operator&(Scalar o) const { return Scalar(value & o.value); }
+  Scalar operator|(Scalar o) const { return Scalar(value | o.value); }
+  Scalar operator^(Scalar o) const { return Scalar(value ^ o.value); }
+  Scalar operator~() const { return Scalar(~value); }
+  Scalar operator+(Scalar o) const { return Scalar(value + o.value); }
+  Scalar operator-(Scalar o) const { return Scalar(value - o.value); }
+};
+
+void analyse_range(const chess::BoardBatch &batch, std::size_t first,
+                   chess::BatchResult &result) {
+  for (std::size_t i = first; i < batch.size(); ++i) {
+    chess::kernels::analyse<Scalar>(batch, i, result);
+  }
+}
+
+void resize(const chess::BoardBatch &batch, chess::BatchResult &result) {
+  result.attacks.resize(batch.size());
+  result.in_check.resize(batch.size());
+  result.legal_moves.resize(batch.size());
+}
+
+} // namespace
+
+void chess::BoardBatch::push_back(const Board &board) {
+  using namespace pieces;
+
+  for (auto &color : pieces) {
+    for (int type = PAWN; type <= KING; ++type) {
+      color[type].push_back(0);
+    }
+  }
+  for (int pos = 0; pos < 64; ++pos) {
+    const int piece = board.square(pos);
+    if (piece != NONE) {
+      pieces[(piece & WHITE) != 0][piece & 7].back() |= 1ull << pos;
+    }
+  }
+
+  white_to_move.push_back(board.turn() == WHITE ? ~0ull : 0);
+  const int target = board.en_passant_square();
+  en_passant.push_back(target == -1 ? 0 : 1ull << target);
+  castling.push_back((board.kingside_castle(WHITE) ? 1ull << 63 : 0) |
+                     (board.queenside_castle(WHITE) ? 1ull << 56 : 0) |
+                     (board.kingside_castle(BLACK) ? 1ull << 7 : 0) |
+                     (board.queenside_castle(BLACK) ? 1ull << 0 : 0));
+}
+
+void chess::BoardBatch::clear() {
+  for (auto &color : pieces) {
+    for (auto &bitboards : color) {
+      bitboards.clear();
+    }
+  }
+  white_to_move.clear();
+  en_passant.clear();
+  castling.clear();
+}
+
+void chess::analyse_batch(const BoardBatch &batch, BatchResult &result) {
+  resize(batch, result);
+  std::size_t done = 0;
+#ifdef CHESS_BATCH_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    done = analyse_batch_avx2(batch, result);
+  }
+#endif
+  analyse_range(batch, done, result);
+}
+
+void chess::analyse_batch_scalar(const BoardBatch &batch, BatchResult &result) {
+  resize(batch, result);
+  analyse_range(batch, 0, result);
+}
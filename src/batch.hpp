@@ -0,0 +1,44 @@
+#ifndef BATCH_HPP_
+#define BATCH_HPP_
+
+#include "board.hpp"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace chess {
+
+// Many independent positions in a structure-of-arrays bitboard layout:
+// the same bitboard of consecutive positions is contiguous, so the kernels
+// load it for several positions with a single instruction. Bit `pos` of a
+// bitboard is square `pos` of `Board`, i.e. bit 0 is a8.
+class BoardBatch {
+public:
+  // [color][piece type], color 0 is black and 1 is white like in `Board`
+  std::array<std::array<std::vector<std::uint64_t>, 7>, 2> pieces;
+  std::vector<std::uint64_t> white_to_move; // all bits set or none
+  std::vector<std::uint64_t> en_passant;    // target square or empty
+  std::vector<std::uint64_t> castling;      // corners of castling rooks
+
+  void push_back(const Board &board);
+  void clear();
+  std::size_t size() const { return white_to_move.size(); }
+};
+
+struct BatchResult {
+  std::vector<std::uint64_t> attacks; // squares attacked by the opponent
+  std::vector<std::uint8_t> in_check;
+  std::vector<std::uint16_t> legal_moves;
+};
+
+// Fills `result` for every position of `batch`, with AVX2 kernels that
+// process four positions at once when the CPU supports them. Counts match
+// `Board::legal_moves`, promotions included as a single (queen) move.
+void analyse_batch(const BoardBatch &batch, BatchResult &result);
+
+// The portable kernels only, for comparison.
+void analyse_batch_scalar(const BoardBatch &batch, BatchResult &result);
+
+} // namespace chess
+
+#endif // BATCH_HPP_
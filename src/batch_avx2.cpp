@@ -0,0 +1,78 @@
+// compiled with -mavx2, only called after checking the CPU supports it
+#include "batch.hpp"
+#include "batch_kernels.hpp"
+#include <immintrin.h>
+
+namespace {
+
+// four positions per lane
+struct Avx2 {
+  static constexpr int width = 4;
+  __m256i value;
+
+  Avx2() = default;
+  explicit Avx2(__m256i v) : value(v) {}
+  explicit Avx2(std::uint64_t v)
+      : value(_mm256_set1_epi64x(static_cast<long long>(v))) {}
+
+  static Avx2 load(const std::uint64_t *p) {
+    return Avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)));
+  }
+  void store(std::uint64_t *p) const {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), value);
+  }
+
+  template <int N> Avx2 shl() const {
+    return Avx2(_mm256_slli_epi64(value, N));
+  }
+  template <int N> Avx2 shr() const {
+    return Avx2(_mm256_srli_epi64(value, N));
+  }
+
+  Avx2 nonzero() const {
+    const __m256i zero = _mm256_cmpeq_epi64(value, _mm256_setzero_si256());
+    return ~Avx2(zero);
+  }
+
+  // nibble lookup, then the bytes of each lane summed
+  Avx2 popcount() const {
+    const __m256i table =
+        _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1,
+                         1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_nibbles = _mm256_set1_epi8(0x0f);
+    const __m256i low = _mm256_and_si256(value, low_nibbles);
+    const __m256i high =
+        _mm256_and_si256(_mm256_srli_epi16(value, 4), low_nibbles);
+    const __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(table, low),
+                                          _mm256_shuffle_epi8(table, high));
+    return Avx2(_mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+  }
+
+  Avx2 operator&(Avx2 o) const {
+    return Avx2(_mm256_and_si256(value, o.value));
+  }
+  Avx2 operator|(Avx2 o) const { return Avx2(_mm256_or_si256(value, o.value)); }
+  Avx2 operator^(Avx2 o) const {
+    return Avx2(_mm256_xor_si256(value, o.value));
+  }
+  Avx2 operator~() const {
+    return Avx2(_mm256_xor_si256(value, _mm256_set1_epi64x(-1)));
+  }
+  Avx2 operator+(Avx2 o) const {
+    return Avx2(_mm256_add_epi64(value, o.value));
+  }
+  Avx2 operator-(Avx2 o) const {
+    return Avx2(_mm256_sub_epi64(value, o.value));
+  }
+};
+
+} // namespace
+
+std::size_t chess::analyse_batch_avx2(const BoardBatch &batch,
+                                      BatchResult &result) {
+  const std::size_t count = batch.size() / Avx2::width * Avx2::width;
+  for (std::size_t i = 0; i < count; i += Avx2::width) {
+    kernels::analyse<Avx2>(batch, i, result);
+  }
+  return count;
+}
@@ -0,0 +1,270 @@
+#ifndef BATCH_KERNELS_HPP_
+#define BATCH_KERNELS_HPP_
+
+#include "batch.hpp"
+#include "tables.hpp"
+#include <array>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+// Set-wise move generation written once over a lane type `V`: a bitboard of
+// one position (scalar) or of several positions (SIMD). `V` provides
+// load/store, bitwise operators, `-`, `+`, shifts by a constant, `nonzero`
+// (all bits set in lanes that are not zero) and per-lane `popcount`.
+//
+// Everything here has internal linkage on purpose: the AVX2 translation
+// unit is compiled with -mavx2 and its copies of these templates must never
+// be merged with the portable ones by the linker.
+
+namespace chess {
+
+// processes the largest multiple of four positions, returns how many
+std::size_t analyse_batch_avx2(const BoardBatch &batch, BatchResult &result);
+
+namespace {
+
+namespace kernels {
+
+constexpr std::uint64_t file_a = 0x0101010101010101ull;
+
+using tables::direction_offsets;
+constexpr std::array<int, 8> knight_offsets = {-17, -15, -10, -6,
+                                               6,   10,  15,  17};
+
+// squares a step by `offset` cannot land on without wrapping around a side
+constexpr std::uint64_t wrap_mask(int offset) {
+  const int file_delta = ((offset + 4) % 8 + 8) % 8 - 4;
+  std::uint64_t mask = ~0ull;
+  for (int file = 0; file < 8; ++file) {
+    if ((file_delta > 0 && file < file_delta) ||
+        (file_delta < 0 && file >= 8 + file_delta)) {
+      mask &= ~(file_a << file);
+    }
+  }
+  return mask;
+}
+
+template <int Count, typename F> void unroll(F &&f) {
+  [&]<int... I>(std::integer_sequence<int, I...>) {
+    (f(std::integral_constant<int, I>{}), ...);
+  }(std::make_integer_sequence<int, Count>{});
+}
+
+template <int Offset, typename V> V shift(V x) {
+  if constexpr (Offset > 0) {
+    return x.template shl<Offset>();
+  } else {
+    return x.template shr<-Offset>();
+  }
+}
+
+template <int Offset, typename V> V step(V x) {
+  return shift<Offset>(x) & V(wrap_mask(Offset));
+}
+
+// Kogge-Stone occluded fill: squares attacked from `from` in the direction,
+// up to and including the first square that is not in `empty`.
+template <int Offset, typename V> V slide(V from, V empty) {
+  V propagate = empty & V(wrap_mask(Offset));
+  from = from | (propagate & shift<Offset>(from));
+  propagate = propagate & shift<Offset>(propagate);
+  from = from | (propagate & shift<2 * Offset>(from));
+  propagate = propagate & shift<2 * Offset>(propagate);
+  from = from | (propagate & shift<4 * Offset>(from));
+  return step<Offset>(from);
+}
+
+template <typename V> V select(V mask, V if_set, V if_clear) {
+  return (if_set & mask) | (~mask & if_clear);
+}
+
+template <typename V> V knight_attacks(V knights) {
+  V attacks(0);
+  unroll<8>([&](auto i) {
+    attacks = attacks | step<knight_offsets[decltype(i)::value]>(knights);
+  });
+  return attacks;
+}
+
+template <typename V> V king_attacks(V kings) {
+  V attacks(0);
+  unroll<8>([&](auto d) {
+    attacks = attacks | step<direction_offsets[decltype(d)::value]>(kings);
+  });
+  return attacks;
+}
+
+// white pawns move towards rank 8, which is towards bit 0
+template <typename V> V white_pawn_attacks(V pawns) {
+  return step<-7>(pawns) | step<-9>(pawns);
+}
+
+template <typename V> V black_pawn_attacks(V pawns) {
+  return step<7>(pawns) | step<9>(pawns);
+}
+
+template <typename V>
+void analyse(const BoardBatch &batch, std::size_t first, BatchResult &result) {
+  using namespace pieces;
+
+  const V white = V::load(&batch.white_to_move[first]);
+  std::array<V, 7> own, enemy;
+  V own_all(0), enemy_all(0);
+  for (int type = PAWN; type <= KING; ++type) {
+    const V white_pieces = V::load(&batch.pieces[1][type][first]);
+    const V black_pieces = V::load(&batch.pieces[0][type][first]);
+    own[type] = select(white, white_pieces, black_pieces);
+    enemy[type] = select(white, black_pieces, white_pieces);
+    own_all = own_all | own[type];
+    enemy_all = enemy_all | enemy[type];
+  }
+  const V empty = ~(own_all | enemy_all);
+  const V king = own[KING];
+  const V enemy_straight = enemy[ROOK] | enemy[QUEEN];
+  const V enemy_diagonal = enemy[BISHOP] | enemy[QUEEN];
+  const auto own_pawn_attacks = [&](V pawns) {
+    return select(white, white_pawn_attacks(pawns), black_pawn_attacks(pawns));
+  };
+
+  const auto enemy_attacks = [&](V empty_squares) {
+    V attacks = select(white, black_pawn_attacks(enemy[PAWN]),
+                       white_pawn_attacks(enemy[PAWN])) |
+                knight_attacks(enemy[KNIGHT]) | king_attacks(enemy[KING]);
+    unroll<8>([&](auto d) {
+      constexpr int D = decltype(d)::value;
+      attacks = attacks | slide<direction_offsets[D]>(
+                              D < 4 ? enemy_straight : enemy_diagonal,
+                              empty_squares);
+    });
+    return attacks;
+  };
+  const V attacks = enemy_attacks(empty);
+  // seen through the king, so it cannot step back along a checking ray
+  const V king_danger = enemy_attacks(empty | king);
+  const V in_check = (attacks & king).nonzero();
+
+  // checkers, the rays between them and the king, and pinned pieces by the
+  // line they are pinned on (vertical, horizontal and the two diagonals)
+  V checkers = (knight_attacks(king) & enemy[KNIGHT]) |
+               (own_pawn_attacks(king) & enemy[PAWN]);
+  V check_rays(0);
+  std::array<V, 4> pinned_on_line = {V(0), V(0), V(0), V(0)};
+  unroll<8>([&](auto d) {
+    constexpr int D = decltype(d)::value;
+    constexpr int offset = direction_offsets[D];
+    const V sliders = D < 4 ? enemy_straight : enemy_diagonal;
+    const V ray = slide<offset>(king, empty);
+    const V checker = ray & sliders;
+    checkers = checkers | checker;
+    check_rays = check_rays | (ray & checker.nonzero());
+    const V blocker = ray & own_all;
+    const V pinner = slide<offset>(king, empty | blocker) & ~ray & sliders;
+    pinned_on_line[D / 2] =
+        pinned_on_line[D / 2] | (blocker & pinner.nonzero());
+  });
+  const V pinned = pinned_on_line[0] | pinned_on_line[1] | pinned_on_line[2] |
+                   pinned_on_line[3];
+  const V double_check = (checkers & (checkers - V(1))).nonzero();
+  const V target = ~own_all & ~double_check &
+                   select(in_check, check_rays | checkers, V(~0ull));
+
+  V count = (king_attacks(king) & ~own_all & ~king_danger).popcount();
+
+  // castling, rights are kept as the corners of the rooks
+  const V rights = V::load(&batch.castling[first]) & own[ROOK];
+  const V on_home_square =
+      (king & select(white, V(1ull << 60), V(1ull << 4))).nonzero() &
+      ~in_check;
+  const V kingside_path = select(white, V(3ull << 61), V(3ull << 5));
+  const V queenside_path = select(white, V(7ull << 57), V(7ull << 1));
+  const V queenside_safe = select(white, V(3ull << 58), V(3ull << 2));
+  const V kingside =
+      on_home_square &
+      (rights & select(white, V(1ull << 63), V(1ull << 7))).nonzero() &
+      ~(~empty & kingside_path).nonzero() &
+      ~(attacks & kingside_path).nonzero();
+  const V queenside =
+      on_home_square &
+      (rights & select(white, V(1ull << 56), V(1ull << 0))).nonzero() &
+      ~(~empty & queenside_path).nonzero() &
+      ~(attacks & queenside_safe).nonzero();
+  count = count + (kingside & V(1)) + (queenside & V(1));
+
+  const V knights = own[KNIGHT] & ~pinned;
+  unroll<8>([&](auto i) {
+    constexpr int offset = knight_offsets[decltype(i)::value];
+    count = count + (step<offset>(knights) & target).popcount();
+  });
+
+  // rays of sliders in one direction never overlap, so counting the union
+  // counts every move; pinned sliders only move along their pin line
+  const V straight = own[ROOK] | own[QUEEN];
+  const V diagonal = own[BISHOP] | own[QUEEN];
+  unroll<8>([&](auto d) {
+    constexpr int D = decltype(d)::value;
+    const V movers =
+        (D < 4 ? straight : diagonal) & (~pinned | pinned_on_line[D / 2]);
+    count = count +
+            (slide<direction_offsets[D]>(movers, empty) & target).popcount();
+  });
+
+  // pawns, promotions count once as only queens are promoted to
+  const V pawns = own[PAWN];
+  const V pushers = pawns & (~pinned | pinned_on_line[0]);
+  const V single = select(white, step<-8>(pushers), step<8>(pushers)) & empty;
+  const V twice = select(white, step<-8>(single & V(0xffull << 40)),
+                         step<8>(single & V(0xffull << 16))) &
+                  empty;
+  const V left = pawns & (~pinned | pinned_on_line[2]);
+  const V right = pawns & (~pinned | pinned_on_line[3]);
+  const V left_captures = select(white, step<-7>(left), step<7>(left));
+  const V right_captures = select(white, step<-9>(right), step<9>(right));
+  count = count + (single & target).popcount() + (twice & target).popcount() +
+          (left_captures & enemy_all & target).popcount() +
+          (right_captures & enemy_all & target).popcount();
+
+  // en passant removes two pieces from a line, so the king safety of each
+  // capture is checked again from scratch
+  const V en_passant = V::load(&batch.en_passant[first]);
+  const V captured =
+      select(white, step<8>(en_passant), step<-8>(en_passant));
+  const auto en_passant_legal = [&](V from, V to) {
+    const V empty_after = (empty | from | captured) & ~to;
+    V attackers = (knight_attacks(king) & enemy[KNIGHT]) |
+                  (own_pawn_attacks(king) & enemy[PAWN] & ~captured);
+    unroll<8>([&](auto d) {
+      constexpr int D = decltype(d)::value;
+      attackers = attackers | (slide<direction_offsets[D]>(king, empty_after) &
+                               (D < 4 ? enemy_straight : enemy_diagonal));
+    });
+    return to.nonzero() & ~attackers.nonzero() & V(1);
+  };
+  const V left_to = select(white, step<-7>(pawns), step<7>(pawns)) & en_passant;
+  const V right_to =
+      select(white, step<-9>(pawns), step<9>(pawns)) & en_passant;
+  count = count +
+          en_passant_legal(select(white, step<7>(left_to), step<-7>(left_to)),
+                           left_to) +
+          en_passant_legal(select(white, step<9>(right_to), step<-9>(right_to)),
+                           right_to);
+
+  std::array<std::uint64_t, V::width> lanes;
+  attacks.store(&result.attacks[first]);
+  in_check.store(lanes.data());
+  for (int lane = 0; lane < V::width; ++lane) {
+    result.in_check[first + lane] = lanes[lane] != 0;
+  }
+  count.store(lanes.data());
+  for (int lane = 0; lane < V::width; ++lane) {
+    result.legal_moves[first + lane] = static_cast<std::uint16_t>(lanes[lane]);
+  }
+}
+
+} // namespace kernels
+
+} // namespace
+
+} // namespace chess
+
+#endif // BATCH_KERNELS_HPP_
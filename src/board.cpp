@@ -1,48 +1,51 @@
 #include "board.hpp"
 #include "src/pieces.hpp"
+#include "stats.hpp"
 #include <algorithm>
 #include <utility>
 
-void chess::Board::precompute_move_data() {
-  for (int rank = 0; rank < 8; ++rank) {
-    for (int file = 0; file < 8; ++file) {
-      const int num_up = rank;
-      const int num_down = 7 - rank;
-      const int num_left = file;
-      const int num_right = 7 - file;
-
-      m_squares_to_edge[rank * 8 + file][0] = num_up;
-      m_squares_to_edge[rank * 8 + file][1] = num_down;
-      m_squares_to_edge[rank * 8 + file][2] = num_left;
-      m_squares_to_edge[rank * 8 + file][3] = num_right;
-      m_squares_to_edge[rank * 8 + file][4] = std::min(num_up, num_right);
-      m_squares_to_edge[rank * 8 + file][5] = std::min(num_down, num_left);
-      m_squares_to_edge[rank * 8 + file][6] = std::min(num_down, num_right);
-      m_squares_to_edge[rank * 8 + file][7] = std::min(num_up, num_left);
-    }
+std::uint64_t chess::Board::castling_and_en_passant_key() const {
+  const int rights = m_kingside_castle[1] | m_queenside_castle[1] << 1 |
+                     m_kingside_castle[0] << 2 | m_queenside_castle[0] << 3;
+  return zobrist::keys.castling[rights] ^
+         (m_en_passant_target_square == -1
+              ? 0
+              : zobrist::keys.en_passant[m_en_passant_target_square % 8]);
+}
+
+std::uint64_t chess::Board::compute_hash() const {
+  std::uint64_t hash = castling_and_en_passant_key();
+  for (int pos = 0; pos < 64; ++pos) {
+    hash ^= zobrist::keys.pieces[m_squares[pos]][pos];
   }
+  if (m_turn == pieces::BLACK) {
+    hash ^= zobrist::keys.black_to_move;
+  }
+  return hash;
 }
 
-void chess::Board::fill_checked_squares() {
-  m_checked_squares.fill(false);
+std::uint64_t chess::Board::compute_pawn_hash() const {
+  std::uint64_t hash = 0;
   for (int pos = 0; pos < 64; ++pos) {
-    for (int square : generate_moves(pos, true)) {
-      m_checked_squares[square] = true;
+    if ((m_squares[pos] & 7) == pieces::PAWN) {
+      hash ^= zobrist::keys.pieces[m_squares[pos]][pos];
     }
   }
+  return hash;
 }
 
 chess::Board::Board(std::string_view fen) {
   parse_board_from_fen(fen);
-  precompute_move_data();
   toggle_turn();
   fill_checked_squares();
   toggle_turn();
-  ++m_positions_counter[to_fen()];
+  m_hash = compute_hash();
+  m_pawn_hash = compute_pawn_hash();
   m_history.push(*this);
 }
 
 void chess::Board::make_move(int from, int to) {
+  STATS_INCREMENT(MAKE_MOVE);
   const int selected_piece = m_squares[from] & ~m_turn;
 
   if (selected_piece == pieces::PAWN ||
@@ -53,19 +56,22 @@ void chess::Board::make_move(int from, int to) {
     ++m_halfmoves_50rule_count;
   }
 
+  // taken out here and put back once the rights and target are updated
+  m_hash ^= castling_and_en_passant_key();
+
   // en passant
   if (selected_piece == pieces::PAWN && to == m_en_passant_target_square) {
     if (m_turn == pieces::WHITE) {
-      m_squares[m_en_passant_target_square + 8] = pieces::NONE;
+      set_square(m_en_passant_target_square + 8, pieces::NONE);
     } else {
-      m_squares[m_en_passant_target_square - 8] = pieces::NONE;
+      set_square(m_en_passant_target_square - 8, pieces::NONE);
     }
     m_en_passant_target_square = -1;
   } else if (selected_piece == pieces::PAWN && std::abs(to - from) == 16) {
     if (m_turn == pieces::WHITE) {
-      m_en_passant_target_square = from - 8;
+      m_en_passant_target_square = static_cast<std::int8_t>(from - 8);
     } else {
-      m_en_passant_target_square = from + 8;
+      m_en_passant_target_square = static_cast<std::int8_t>(from + 8);
     }
   } else {
     m_en_passant_target_square = -1;
@@ -83,38 +89,48 @@ void chess::Board::make_move(int from, int to) {
     }
   }
 
-  // castling
+  // castling, the squares the rook lands on are empty
   if (selected_piece == pieces::KING && to - from == 2) {
-    std::swap(m_squares[to - 1], m_squares[to + 1]);
+    set_square(to - 1, m_squares[to + 1]);
+    set_square(to + 1, pieces::NONE);
   } else if (selected_piece == pieces::KING && to - from == -2) {
-    std::swap(m_squares[to - 2], m_squares[to + 1]);
+    set_square(to + 1, m_squares[to - 2]);
+    set_square(to - 2, pieces::NONE);
   }
 
   if (selected_piece == pieces::KING) {
-    m_king_pos[m_turn != pieces::BLACK] = to;
+    m_king_pos[m_turn != pieces::BLACK] = static_cast<std::int8_t>(to);
   }
 
-  m_squares[to] = std::exchange(m_squares[from], pieces::NONE);
-
   // promotion (TODO: not only queen)
   if ((to / 8 == 7 || to / 8 == 0) && selected_piece == pieces::PAWN) {
-    m_squares[to] = m_turn | pieces::QUEEN;
+    set_square(to, m_turn | pieces::QUEEN);
+  } else {
+    set_square(to, m_squares[from]);
   }
+  set_square(from, pieces::NONE);
 
-  m_selected_piece_square = -1;
+  m_hash ^= castling_and_en_passant_key();
 
   if (m_turn == pieces::BLACK) {
     ++m_moves_count;
   }
 
-  std::string board_string_repr = to_fen();
-  auto it = board_string_repr.find_first_of(' ');
-  board_string_repr =
-      std::string(board_string_repr.begin(), board_string_repr.begin() + it);
-  m_position_occured_max_count = std::max(
-      ++m_positions_counter[board_string_repr], m_position_occured_max_count);
   fill_checked_squares();
   toggle_turn();
+
+  // the same position with the same side to move since the last capture or
+  // pawn move; the top of the history is the position one ply ago
+  const auto &positions = m_history.positions();
+  int repetitions = 1;
+  for (int ply = 2; ply <= m_halfmoves_50rule_count &&
+                    ply <= static_cast<int>(positions.size());
+       ply += 2) {
+    repetitions += positions[positions.size() - ply].m_hash == m_hash;
+  }
+  m_position_occured_max_count = static_cast<std::uint8_t>(
+      std::max<int>(repetitions, m_position_occured_max_count));
+
   m_history.push(*this);
 }
 
@@ -122,6 +138,7 @@ void chess::Board::unmake_move() {
   if (m_history.size() <= 1) {
     return;
   }
+  STATS_INCREMENT(UNMAKE_MOVE);
   m_history.pop();
   *this = m_history.top();
 }
@@ -131,17 +148,8 @@ chess::Board::State chess::Board::game_state() {
     return State::DRAW;
   }
 
-  const bool check = king_checked();
-  bool legal_moves = false;
-  for (int i = 0; i < 64; ++i) {
-    if (!generate_moves(i).empty()) {
-      legal_moves = true;
-      break;
-    }
-  }
-
-  if (!legal_moves) {
-    return check ? State::MATE : State::DRAW;
+  if (!has_legal_move()) {
+    return king_checked() ? State::MATE : State::DRAW;
   }
   return State::PLAYING;
 }
@@ -3,60 +3,110 @@
 
 #include <raylib-cpp.hpp>
 #include <array>
+#include <cstdint>
 #include <stack>
+#include <string>
 #include <string_view>
-#include <unordered_map>
+#include <type_traits>
 #include <unordered_set>
 #include <vector>
+#include "move.hpp"
 #include "pieces.hpp"
+#include "tables.hpp"
 
 namespace chess {
 
 class Board {
+  friend class Bench;
+
 private:
-  std::array<int, 64> m_squares = {pieces::NONE};
-  int m_turn = pieces::WHITE;
-  int m_selected_piece_square = -1;
-  int m_en_passant_target_square = -1;
+  std::array<std::int8_t, 64> m_squares = {};
+  std::uint64_t m_hash = 0;            // zobrist key of the position
+  std::uint64_t m_pawn_hash = 0;       // zobrist key of the pawns only
+  std::uint64_t m_checked_squares = 0; // attacked by the opponent, by bit
+  std::int8_t m_turn = pieces::WHITE;
+  std::int8_t m_en_passant_target_square = -1;
   std::array<bool, 2> m_kingside_castle = {false, false};
   std::array<bool, 2> m_queenside_castle = {false, false};
-  std::array<int, 2> m_king_pos = {0, 0};
-  int m_moves_count = 0;
-  int m_halfmoves_50rule_count = 0;
-
-  // TODO: `zobrist hashing`, much faster.
-  std::unordered_map<std::string, int> m_positions_counter;
-  int m_position_occured_max_count = 1;
+  std::array<std::int8_t, 2> m_king_pos = {0, 0};
+  std::uint8_t m_position_occured_max_count = 1;
+  std::uint16_t m_moves_count = 0;
+  std::uint16_t m_halfmoves_50rule_count = 0;
 
 public:
-  using Stack = std::stack<Board, std::vector<Board>>;
+  // positions played so far, the top is the current one
+  class Stack : public std::stack<Board, std::vector<Board>> {
+  public:
+    const std::vector<Board> &positions() const { return c; }
+  };
+
   void make_move(int from, int to);
   void unmake_move();
   std::unordered_set<int> generate_moves(int from, bool gen_threats = false);
+  // valid until the moves of another position are asked for on this thread
+  const MoveList &legal_moves();
+  bool has_legal_move();
 
-  const std::array<bool, 64> &checked_squares() const {
-    return m_checked_squares;
-  }
+  // squares attacked by the opponent, bit `pos` for square `pos`
+  std::uint64_t checked_squares() const { return m_checked_squares; }
 
   int square(int pos) const { return m_squares[pos]; }
+  int turn() const { return m_turn; }
+  std::uint64_t hash() const { return m_hash; }
+  std::uint64_t pawn_hash() const { return m_pawn_hash; }
+  int halfmove_clock() const { return m_halfmoves_50rule_count; }
+  int en_passant_square() const { return m_en_passant_target_square; }
+  bool kingside_castle(int color) const {
+    return m_kingside_castle[color != pieces::BLACK];
+  }
+  bool queenside_castle(int color) const {
+    return m_queenside_castle[color != pieces::BLACK];
+  }
+
+  bool king_checked() const {
+    return (m_checked_squares >> m_king_pos[m_turn != pieces::BLACK] & 1) != 0;
+  }
 
   Stack &history() { return m_history; }
 
 private:
-  inline static Stack m_history;
-
-  bool king_checked() const {
-    return m_checked_squares[m_king_pos[m_turn != pieces::BLACK]];
+  // One history per thread, so a background job can make and unmake moves on
+  // its own copy of the board. Such a copy has to be pushed first.
+  inline static thread_local Stack m_history;
+
+  // Legal moves of recently seen positions by hash, one table per thread
+  // like the history and kept out of the board so that copies stay small.
+  struct LegalMoves {
+    std::uint64_t hash = 0;
+    bool valid = false;
+    MoveList moves;
+  };
+  static thread_local std::array<LegalMoves, 64> m_legal_moves;
+
+  // Visitors are called with every target square and return true to stop
+  // the generation, in which case the function returns true as well.
+  template <typename Visitor>
+  bool visit_moves(int from, bool gen_threats, Visitor &&visit) const;
+  template <typename Visitor>
+  bool visit_pawn_moves(int from, bool gen_threats, Visitor &&visit) const;
+  template <typename Visitor>
+  bool visit_knight_moves(int from, bool gen_threats, Visitor &&visit) const;
+  template <typename Visitor>
+  bool visit_king_moves(int from, bool gen_threats, Visitor &&visit) const;
+  template <typename Visitor>
+  bool visit_sliding_piece_moves(int from, bool gen_threats,
+                                 Visitor &&visit) const;
+
+  bool square_attacked(int square, int by) const;
+  bool empty_squares(std::uint64_t squares) const {
+    for (; squares != 0; squares &= squares - 1) {
+      if (m_squares[std::countr_zero(squares)] != pieces::NONE) {
+        return false;
+      }
+    }
+    return true;
   }
-
-  std::unordered_set<int> generate_pawn_moves(int from,
-                                              bool gen_threats = false) const;
-  std::unordered_set<int> generate_knight_moves(int from,
-                                                bool gen_threats = false) const;
-  std::unordered_set<int> generate_king_moves(int from,
-                                              bool gen_threats = false) const;
-  std::unordered_set<int>
-  generate_sliding_piece_moves(int from, bool gen_threats = false) const;
+  bool is_legal(int from, int to);
 
   void toggle_turn() {
     if (m_turn == pieces::BLACK) {
@@ -64,14 +114,27 @@ private:
     } else {
       m_turn = pieces::BLACK;
     }
+    m_hash ^= zobrist::keys.black_to_move;
   }
 
-  static constexpr std::array<int, 8> m_direction_offsets = {-8, 8, -1, 1,
-                                                             -7, 7, 9,  -9};
-  std::array<std::array<int, 8>, 64> m_squares_to_edge;
-  std::array<bool, 64> m_checked_squares;
+  // every change of a square goes through here to keep the hashes up to date
+  void set_square(int pos, int piece) {
+    const auto removed = zobrist::keys.pieces[m_squares[pos]][pos];
+    const auto added = zobrist::keys.pieces[piece][pos];
+    m_hash ^= removed ^ added;
+    if ((m_squares[pos] & 7) == pieces::PAWN) {
+      m_pawn_hash ^= removed;
+    }
+    if ((piece & 7) == pieces::PAWN) {
+      m_pawn_hash ^= added;
+    }
+    m_squares[pos] = static_cast<std::int8_t>(piece);
+  }
 
-  void precompute_move_data();
+  std::uint64_t castling_and_en_passant_key() const;
+  std::uint64_t compute_hash() const;
+  std::uint64_t compute_pawn_hash() const;
+  Board() = default; // empty, for `parse_board_from_fen`
   void parse_board_from_fen(std::string_view fen);
   void fill_checked_squares();
 
@@ -80,10 +143,26 @@ public:
 
   explicit Board(std::string_view fen);
 
+  // Whether `fen` can be given to the constructor: the placement of 8 ranks
+  // of 8 squares with one king and at most 16 pieces and 8 pawns per side,
+  // none on the first or last rank, then the side to move and optionally
+  // castling, en passant and the move counters. Castling rights need the
+  // king and the rook on their starting squares, and the side not to move
+  // may not be in check. Anything else may not be safe to construct.
+  static bool valid_fen(std::string_view fen);
+
   State game_state();
   std::string to_fen() const;
 };
 
+// Boards are copied onto the history on every move, so they are kept small
+// and free of anything that allocates.
+static_assert(std::is_trivially_copyable_v<Board>);
+static_assert(sizeof(Board) <= 104);
+
+// defined out of the class, which has to be complete for the initializers
+inline thread_local std::array<Board::LegalMoves, 64> Board::m_legal_moves;
+
 } // namespace chess
 
 #endif // BOARD_HPP_
@@ -11,6 +11,11 @@ constexpr int BOARD_HEIGHT = SQUARE_SIZE * 8;
 constexpr std::string_view WINDOW_TITLE = "Chess";
 constexpr int FPS = 60;
 
+// search results shared with earlier and later sessions, in the working
+// directory
+constexpr std::string_view ANALYSIS_CACHE_PATH = "analysis.cache";
+constexpr int ANALYSIS_TIME_MS = 1000;
+
 } // namespace chess
 
 #endif // CONSTANTS_HPP_
@@ -111,6 +111,9 @@ void chess::Board::parse_board_from_fen(std::string_view fen) {
   early_return(i == fen.size());
 
   // catling abilities
+  if (fen[i] == '-') {
+    ++i;
+  }
   while (i < fen.size() && std::isalpha(fen[i])) {
     switch (fen[i]) {
     case 'K':
@@ -159,6 +162,111 @@ void chess::Board::parse_board_from_fen(std::string_view fen) {
   }
 }
 
+bool chess::Board::valid_fen(std::string_view fen) {
+  std::array<std::string_view, 6> fields;
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < fen.size();) {
+    if (std::isspace(static_cast<unsigned char>(fen[i]))) {
+      ++i;
+      continue;
+    }
+    const std::size_t end = std::min(fen.find_first_of(" \t\r\n", i),
+                                     fen.size());
+    if (count == fields.size()) {
+      return false;
+    }
+    fields[count++] = fen.substr(i, end - i);
+    i = end;
+  }
+  if (count < 2) {
+    return false;
+  }
+
+  // pieces, no more than a side starts with (room for 256 legal moves)
+  int rank = 0, file = 0, white_kings = 0, black_kings = 0;
+  std::array<int, 2> piece_counts = {0, 0}, pawn_counts = {0, 0};
+  for (const char c : fields[0]) {
+    if (c == '/') {
+      if (file != 8 || ++rank > 7) {
+        return false;
+      }
+      file = 0;
+    } else if ('1' <= c && c <= '8') {
+      file += c - '0';
+    } else if (std::string_view("pnbrqkPNBRQK").find(c) !=
+               std::string_view::npos) {
+      const bool white = std::isupper(static_cast<unsigned char>(c));
+      if ((c == 'p' || c == 'P') && (rank == 0 || rank == 7)) {
+        return false;
+      }
+      white_kings += c == 'K';
+      black_kings += c == 'k';
+      ++piece_counts[white];
+      pawn_counts[white] += c == 'p' || c == 'P';
+      ++file;
+    } else {
+      return false;
+    }
+    if (file > 8) {
+      return false;
+    }
+  }
+  if (rank != 7 || file != 8 || white_kings != 1 || black_kings != 1 ||
+      piece_counts[0] > 16 || piece_counts[1] > 16 || pawn_counts[0] > 8 ||
+      pawn_counts[1] > 8) {
+    return false;
+  }
+
+  // turn
+  if (fields[1] != "w" && fields[1] != "b") {
+    return false;
+  }
+
+  // castling abilities
+  if (count > 2 && fields[2] != "-" &&
+      fields[2].find_first_not_of("KQkq") != std::string_view::npos) {
+    return false;
+  }
+
+  // en passant target, behind a pawn the opponent just pushed two squares
+  if (count > 3 && fields[3] != "-" &&
+      (fields[3].size() != 2 || fields[3][0] < 'a' || fields[3][0] > 'h' ||
+       fields[3][1] != (fields[1] == "w" ? '6' : '3'))) {
+    return false;
+  }
+
+  // move counters
+  for (std::size_t i = 4; i < count; ++i) {
+    if (fields[i].size() > 4 ||
+        fields[i].find_first_not_of("0123456789") != std::string_view::npos) {
+      return false;
+    }
+  }
+
+  Board board;
+  board.parse_board_from_fen(fen);
+
+  // castling needs the king and the rook on their starting squares, move
+  // generation looks for the rook next to the king's square
+  for (const int color : {pieces::BLACK, pieces::WHITE}) {
+    const int side = color != pieces::BLACK;
+    const int king = side ? 60 : 4;
+    const bool king_home = board.m_squares[king] == (color | pieces::KING);
+    if (board.m_kingside_castle[side] &&
+        (!king_home || board.m_squares[king + 3] != (color | pieces::ROOK))) {
+      return false;
+    }
+    if (board.m_queenside_castle[side] &&
+        (!king_home || board.m_squares[king - 4] != (color | pieces::ROOK))) {
+      return false;
+    }
+  }
+
+  // the side that just moved can not have left its king in check
+  return !board.square_attacked(board.m_king_pos[board.m_turn == pieces::BLACK],
+                                board.m_turn);
+}
+
 std::string chess::Board::to_fen() const {
   using namespace pieces;
 
@@ -1,19 +1,31 @@
+#include <algorithm>
 #include <chrono>
 #include "game.hpp"
 #include "constants.hpp"
+#include "notation.hpp"
+#include "stats.hpp"
 
 chess::Game::Game(std::string_view fen) : m_board(chess::Board{fen}) {
-  using namespace pieces;
+  load_piece_textures();
+  if (m_analysis_cache == nullptr) {
+    TraceLog(LOG_WARNING, "Cannot open %s, analysing without it",
+             ANALYSIS_CACHE_PATH.data());
+  }
+  update_legal_moves();
+  start_analysis();
+}
+
+void chess::Game::load_piece_textures() {
   for (int piece = pieces::PAWN; piece <= pieces::KING; ++piece) {
     int piecew = piece | pieces::WHITE;
     int pieceb = piece | pieces::BLACK;
 
     raylib::Image imgw = raylib::Image(m_textures_paths[piecew])
-                             .Resize(SQUARE_SIZE, SQUARE_SIZE)
+                             .Resize(m_square_size, m_square_size)
                              .Mipmaps();
 
     raylib::Image imgb = raylib::Image(m_textures_paths[pieceb])
-                             .Resize(SQUARE_SIZE, SQUARE_SIZE)
+                             .Resize(m_square_size, m_square_size)
                              .Mipmaps();
 
     m_piece_textures[piecew] = raylib::Texture(imgw);
@@ -21,25 +33,22 @@ chess::Game::Game(std::string_view fen) : m_board(chess::Board{fen}) {
   }
 }
 
-unsigned long long chess::Game::perft(int depth) {
+unsigned long long chess::Game::perft(Board &board, int depth,
+                                      std::stop_token token,
+                                      std::atomic<float> *progress) {
+  STATS_INCREMENT(NODES);
   unsigned long long nodes = 0;
-  std::vector<std::pair<int, int>> moves;
-  moves.reserve(256);
-
-  for (int from = 0; from < 64; ++from) {
-    const auto &m = m_board.generate_moves(from);
-    for (int to : m) {
-      moves.emplace_back(from, to);
-    }
-  }
+  // a copy, the moves of other positions may take the place of the list
+  const MoveList moves = board.legal_moves();
 
   if (depth == 1) {
     return moves.size();
   }
 
-  for (const auto &[from, to] : moves) {
-    m_board.make_move(from, to);
-    const auto pt = perft(depth - 1);
+  for (int i = 0; i < moves.size() && !token.stop_requested(); ++i) {
+    const auto [from, to] = moves[i];
+    board.make_move(from, to);
+    const auto pt = perft(board, depth - 1, token);
     nodes += pt;
     /*
     if (depth == 3)
@@ -48,42 +57,86 @@ unsigned long long chess::Game::perft(int depth) {
           (to_algebraic_notation(from) + to_algebraic_notation(to)).c_str(),
           pt);
     */
-    m_board.unmake_move();
+    board.unmake_move();
+    if (progress != nullptr) {
+      *progress = static_cast<float>(i + 1) / moves.size();
+    }
   }
   return nodes;
 }
 
-void chess::Game::draw_board() {
-  // Perftest on space
-  if (IsKeyPressed(KEY_SPACE)) {
-    for (int depth = 1; depth < 4; ++depth) {
+void chess::Game::start_perft() {
+  m_perft_job.start([board = m_board](std::stop_token token,
+                                      std::atomic<float> &progress) mutable {
+    board.history().push(board);
+    unsigned long long res = 0;
+    for (int depth = 1; depth < 4 && !token.stop_requested(); ++depth) {
       using namespace std::chrono;
       const auto t1 = high_resolution_clock::now();
-      const auto res = perft(depth);
+      res = perft(board, depth, token, &progress);
       const auto t2 = high_resolution_clock::now();
-      TraceLog(LOG_WARNING, "Found %llu positions in %d ms", res,
-               duration_cast<milliseconds>(t2 - t1));
+      if (!token.stop_requested()) {
+        TraceLog(LOG_WARNING, "Found %llu positions in %d ms", res,
+                 static_cast<int>(
+                     duration_cast<milliseconds>(t2 - t1).count()));
+      }
     }
-    TraceLog(LOG_WARNING, "end");
+    return res;
+  });
+}
+
+void chess::Game::update_legal_moves() {
+  m_legal_moves.reset();
+  m_moves_job.start([board = m_board](std::stop_token token,
+                                      std::atomic<float> &progress) mutable {
+    board.history().push(board);
+    MovesTable moves;
+    for (int pos = 0; pos < 64 && !token.stop_requested(); ++pos) {
+      moves[pos] = board.generate_moves(pos);
+      progress = (pos + 1) / 64.0f;
+    }
+    return moves;
+  });
+}
+
+void chess::Game::start_analysis() {
+  m_analysis.reset();
+  if (m_board.game_state() != Board::State::PLAYING) {
+    m_analysis_job.cancel();
+    return;
+  }
+  m_analysis_job.start([board = m_board, cache = m_analysis_cache.get()](
+                           std::stop_token token,
+                           std::atomic<float> &) mutable {
+    board.history().push(board);
+    return Search(SearchLimits{.time_ms = ANALYSIS_TIME_MS}, cache)
+        .run(board, token);
+  });
+}
+
+void chess::Game::resize_board() {
+  // the largest board fitting the window, which is never smaller than the
+  // initial one
+  const int square_size =
+      std::max(SQUARE_SIZE,
+               std::min(GetScreenWidth(), GetScreenHeight()) / 8);
+  if (square_size == m_square_size) {
+    return;
   }
+  m_square_size = square_size;
+  m_board_texture = raylib::RenderTexture(square_size * 8, square_size * 8);
+  load_piece_textures();
+  m_dirty = true;
+}
 
+void chess::Game::render_board() {
+  m_board_texture.BeginMode();
   for (int rank = 0; rank < 8; ++rank) {
     for (int file = 0, pos = rank * 8; file < 8; ++file, ++pos) {
-      raylib::Rectangle rect{static_cast<float>(file) * SQUARE_SIZE,
-                             static_cast<float>(rank) * SQUARE_SIZE,
-                             static_cast<float>(SQUARE_SIZE),
-                             static_cast<float>(SQUARE_SIZE)};
-
-      if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) &&
-          rect.CheckCollision(GetMousePosition())) {
-        if (m_possible_moves.find(pos) != m_possible_moves.end()) {
-          m_board.make_move(m_selected_piece_square, pos);
-          m_possible_moves.clear();
-        } else {
-          m_selected_piece_square = pos;
-          m_possible_moves = m_board.generate_moves(pos);
-        }
-      }
+      raylib::Rectangle rect{static_cast<float>(file) * m_square_size,
+                             static_cast<float>(rank) * m_square_size,
+                             static_cast<float>(m_square_size),
+                             static_cast<float>(m_square_size)};
 
       int square_color =
           (rank + file) % 2 == 1 ? m_black_square_color : m_white_square_color;
@@ -92,20 +145,126 @@ void chess::Game::draw_board() {
       }
       rect.Draw(raylib::Color(square_color));
       if constexpr (m_draw_checked) {
-        if (m_board.checked_squares()[pos]) {
+        if ((m_board.checked_squares() >> pos & 1) != 0) {
           rect.Draw(raylib::Color(0, 255, 0, 120));
         }
       }
 
-      m_piece_textures[m_board.square(pos)].Draw(
-          raylib::Vector2{static_cast<float>(file) * SQUARE_SIZE,
-                          static_cast<float>(rank) * SQUARE_SIZE});
+      if (m_board.square(pos) != pieces::NONE) {
+        m_piece_textures[m_board.square(pos)].Draw(
+            raylib::Vector2{static_cast<float>(file) * m_square_size,
+                            static_cast<float>(rank) * m_square_size});
+      }
 
       if (m_possible_moves.find(pos) != m_possible_moves.end()) {
         const auto center = (rect.GetPosition() +
-                             Vector2{SQUARE_SIZE / 2.0f, SQUARE_SIZE / 2.0f});
-        center.DrawCircle(SQUARE_SIZE / 7.0f, m_circle_color);
+                             Vector2{m_square_size / 2.0f,
+                                     m_square_size / 2.0f});
+        center.DrawCircle(m_square_size / 7.0f, m_circle_color);
+      }
+    }
+  }
+  m_board_texture.EndMode();
+  m_dirty = false;
+}
+
+void chess::Game::draw_board() {
+  if (auto moves = m_moves_job.take()) {
+    m_legal_moves = std::move(moves);
+    if (m_selected_piece_square != -1) {
+      m_possible_moves = (*m_legal_moves)[m_selected_piece_square];
+      m_dirty = true;
+    }
+  }
+  if (auto analysis = m_analysis_job.take()) {
+    m_analysis = analysis;
+  }
+  if (m_perft_job.take()) {
+    TraceLog(LOG_WARNING, "end");
+#ifdef CHESS_STATS
+    TraceLog(LOG_WARNING, "%s", stats::report().c_str());
+#endif
+  }
+
+  // Perftest on space, pressing again cancels it
+  if (IsKeyPressed(KEY_SPACE)) {
+    if (m_perft_job.running()) {
+      m_perft_job.cancel();
+      TraceLog(LOG_WARNING, "Perft cancelled");
+    } else {
+      start_perft();
+    }
+  }
+
+  if (IsWindowResized()) {
+    resize_board();
+  }
+
+  const int board_size = m_square_size * 8;
+  const auto mouse = GetMousePosition();
+  if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && 0 <= mouse.x &&
+      mouse.x < board_size && 0 <= mouse.y && mouse.y < board_size) {
+    const int pos = static_cast<int>(mouse.y) / m_square_size * 8 +
+                    static_cast<int>(mouse.x) / m_square_size;
+    if (m_possible_moves.find(pos) != m_possible_moves.end()) {
+      m_board.make_move(m_selected_piece_square, pos);
+      m_possible_moves.clear();
+      m_perft_job.cancel();
+      update_legal_moves();
+      start_analysis();
+    } else {
+      // if the moves are not ready yet they are shown once computed
+      m_selected_piece_square = pos;
+      m_possible_moves.clear();
+      if (m_legal_moves) {
+        m_possible_moves = (*m_legal_moves)[pos];
       }
     }
+    m_dirty = true;
+  }
+
+  if (m_dirty) {
+    render_board();
+  }
+
+  ClearBackground(m_background_color);
+  // render textures are stored upside down
+  DrawTextureRec(m_board_texture.texture,
+                 raylib::Rectangle{0.0f, 0.0f, static_cast<float>(board_size),
+                                   -static_cast<float>(board_size)},
+                 raylib::Vector2{0.0f, 0.0f}, raylib::Color(255, 255, 255));
+
+  if (m_perft_job.running()) {
+    DrawText(TextFormat("Perft: %d%%",
+                        static_cast<int>(m_perft_job.progress() * 100)),
+             m_square_size / 8, m_square_size / 8, m_square_size / 4,
+             m_text_color);
+  }
+
+  if (m_analysis && m_analysis->depth > 0) {
+    // from white's point of view
+    const int score = m_board.turn() == pieces::WHITE ? m_analysis->score
+                                                      : -m_analysis->score;
+    const auto text =
+        Search::is_mate_score(score)
+            ? TextFormat("%s  #%d  depth %d",
+                         to_coordinate(m_board, m_analysis->best_move).c_str(),
+                         (score > 0 ? Search::MATE - score + 1
+                                    : -Search::MATE - score - 1) /
+                             2,
+                         m_analysis->depth)
+            : TextFormat("%s  %+.2f  depth %d",
+                         to_coordinate(m_board, m_analysis->best_move).c_str(),
+                         score / 100.0, m_analysis->depth);
+    DrawText(text, m_square_size / 8, board_size - m_square_size * 3 / 8,
+             m_square_size / 4, m_text_color);
+  }
+
+  // Sleep until the next input event unless a job has to be polled
+  if (m_moves_job.running() || m_perft_job.running() ||
+      m_analysis_job.running()) {
+    DisableEventWaiting();
+  } else {
+    EnableEventWaiting();
   }
 }
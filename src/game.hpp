@@ -1,8 +1,16 @@
 #ifndef GAME_HPP_
 #define GAME_HPP_
 
+#include "analysis_cache.hpp"
 #include "board.hpp"
 #include "constants.hpp"
+#include "job.hpp"
+#include "search.hpp"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <stop_token>
 #include <string_view>
 #include <vector>
 
@@ -16,12 +24,38 @@ private:
   int m_selected_piece_square = -1;
   std::unordered_set<int> m_possible_moves;
 
+  // declared before the jobs, which may still be using it when destroyed
+  std::unique_ptr<AnalysisCache> m_analysis_cache =
+      AnalysisCache::open(std::string(ANALYSIS_CACHE_PATH),
+                          Search::EVALUATION_VERSION);
+
+  // Legal moves of every square, computed in background after each move.
+  using MovesTable = std::array<std::unordered_set<int>, 64>;
+  Job<MovesTable> m_moves_job;
+  std::optional<MovesTable> m_legal_moves;
+  Job<unsigned long long> m_perft_job;
+  // best move of the current position, shown at the bottom of the board
+  Job<SearchResult> m_analysis_job;
+  std::optional<SearchResult> m_analysis;
+
   const raylib::Color m_white_square_color = raylib::Color(240, 217, 181);
   const raylib::Color m_black_square_color = raylib::Color(181, 136, 99);
   const raylib::Color m_circle_color = raylib::Color(130, 151, 105);
+  const raylib::Color m_text_color = raylib::Color(40, 40, 40);
+  const raylib::Color m_background_color = raylib::Color(48, 46, 43);
   static constexpr bool m_draw_checked = false;
 
-  std::unordered_map<int, raylib::Texture> m_piece_textures;
+  // indexed by piece code, e.g. pieces::BLACK | pieces::QUEEN
+  std::array<raylib::Texture, 32> m_piece_textures;
+
+  // The board is drawn into a texture only when something on it changes.
+  // It fills the window, squares are SQUARE_SIZE until the window grows.
+  int m_square_size = SQUARE_SIZE;
+  raylib::RenderTexture m_board_texture{BOARD_WIDTH, BOARD_HEIGHT};
+  bool m_dirty = true;
+  void render_board();
+  void resize_board();
+  void load_piece_textures();
   std::unordered_map<int, std::string> m_textures_paths = {
       {pieces::WHITE | pieces::PAWN, "../bin/white-pawn.png"},
       {pieces::WHITE | pieces::KNIGHT, "../bin/white-knight.png"},
@@ -42,7 +76,12 @@ private:
                        static_cast<char>('0' + 8 - pos / 8)};
   }
 
-  unsigned long long perft(int depth = 3);
+  static unsigned long long perft(Board &board, int depth,
+                                  std::stop_token token,
+                                  std::atomic<float> *progress = nullptr);
+  void start_perft();
+  void update_legal_moves();
+  void start_analysis();
 
 public:
   explicit Game(std::string_view fen =
@@ -1,33 +1,42 @@
 #include "board.hpp"
 #include "raylib.h"
+#include "stats.hpp"
+#include <bit>
 #include <utility>
 
-std::unordered_set<int>
-chess::Board::generate_pawn_moves(int from, bool gen_threats) const {
+template <typename Visitor>
+bool chess::Board::visit_pawn_moves(int from, bool gen_threats,
+                                    Visitor &&visit) const {
   const int file = from % 8;
   const int rank = from / 8;
 
-  std::unordered_set<int> moves;
-
   switch (m_squares[from] & pieces::WHITE) {
   case pieces::WHITE:
     if (rank == 6 && m_squares[40 + file] == pieces::NONE &&
         m_squares[32 + file] == pieces::NONE && !gen_threats) {
-      moves.insert(32 + file);
+      if (visit(32 + file)) {
+        return true;
+      }
     }
-    if (from - 8 > 0 && m_squares[from - 8] == pieces::NONE && !gen_threats) {
-      moves.insert(from - 8);
+    if (from - 8 >= 0 && m_squares[from - 8] == pieces::NONE && !gen_threats) {
+      if (visit(from - 8)) {
+        return true;
+      }
     }
 
-    if (file != 7 && from - 7 > 0 &&
+    if (file != 7 && from - 7 >= 0 &&
         ((m_squares[from - 7] & pieces::BLACK) != 0 ||
          from - 7 == m_en_passant_target_square || gen_threats)) {
-      moves.insert(from - 7);
+      if (visit(from - 7)) {
+        return true;
+      }
     }
-    if (file != 0 && from - 9 > 0 &&
+    if (file != 0 && from - 9 >= 0 &&
         ((m_squares[from - 9] & pieces::BLACK) != 0 ||
          from - 9 == m_en_passant_target_square || gen_threats)) {
-      moves.insert(from - 9);
+      if (visit(from - 9)) {
+        return true;
+      }
     }
 
     break;
@@ -35,21 +44,29 @@ chess::Board::generate_pawn_moves(int from, bool gen_threats) const {
   case 0:
     if (rank == 1 && m_squares[16 + file] == pieces::NONE &&
         m_squares[24 + file] == pieces::NONE && !gen_threats) {
-      moves.insert(24 + file);
+      if (visit(24 + file)) {
+        return true;
+      }
     }
     if (from + 8 < 64 && m_squares[from + 8] == pieces::NONE && !gen_threats) {
-      moves.insert(from + 8);
+      if (visit(from + 8)) {
+        return true;
+      }
     }
 
     if (file != 0 && from + 7 < 64 &&
         ((m_squares[from + 7] & pieces::WHITE) != 0 ||
          from + 7 == m_en_passant_target_square || gen_threats)) {
-      moves.insert(from + 7);
+      if (visit(from + 7)) {
+        return true;
+      }
     }
     if (file != 7 && from + 9 < 64 &&
         ((m_squares[from + 9] & pieces::WHITE) != 0 ||
          from + 9 == m_en_passant_target_square || gen_threats)) {
-      moves.insert(from + 9);
+      if (visit(from + 9)) {
+        return true;
+      }
     }
 
     break;
@@ -58,31 +75,27 @@ chess::Board::generate_pawn_moves(int from, bool gen_threats) const {
     std::unreachable();
   }
 
-  return moves;
+  return false;
 }
 
-std::unordered_set<int>
-chess::Board::generate_knight_moves(int from, bool gen_threats) const {
-  const int file = from % 8;
-  const int rank = from / 8;
-
-  std::unordered_set<int> moves;
-  constexpr std::array<std::array<int, 2>, 8> shifts = {
-      {{-2, -1}, {-2, 1}, {-1, 2}, {1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}}};
-  for (const auto [dy, dx] : shifts) {
-    if (0 <= rank + dy && rank + dy < 8 && 0 <= file + dx && file + dx < 8 &&
-        ((m_squares[(rank + dy) * 8 + file + dx] & m_turn) == 0 ||
-         gen_threats)) {
-      moves.insert((rank + dy) * 8 + file + dx);
+template <typename Visitor>
+bool chess::Board::visit_knight_moves(int from, bool gen_threats,
+                                      Visitor &&visit) const {
+  for (auto targets = tables::knight_attacks[from]; targets != 0;
+       targets &= targets - 1) {
+    const int to = std::countr_zero(targets);
+    if ((m_squares[to] & m_turn) == 0 || gen_threats) {
+      if (visit(to)) {
+        return true;
+      }
     }
   }
-  return moves;
+  return false;
 }
 
-std::unordered_set<int>
-chess::Board::generate_sliding_piece_moves(int from, bool gen_threats) const {
-  std::unordered_set<int> moves;
-
+template <typename Visitor>
+bool chess::Board::visit_sliding_piece_moves(int from, bool gen_threats,
+                                             Visitor &&visit) const {
   int start_index = 0, end_index = 8;
   int sq_piece = m_squares[from] & ~m_turn;
 
@@ -96,21 +109,25 @@ chess::Board::generate_sliding_piece_moves(int from, bool gen_threats) const {
 
   for (int direction_index = start_index; direction_index < end_index;
        ++direction_index) {
-    for (int i = 0; i < m_squares_to_edge[from][direction_index]; ++i) {
+    for (int i = 0; i < tables::squares_to_edge[from][direction_index]; ++i) {
       const int target_pos =
-          from + m_direction_offsets[direction_index] * (i + 1);
+          from + tables::direction_offsets[direction_index] * (i + 1);
       if (target_pos > 63) {
         break;
       }
 
       if ((m_squares[target_pos] & m_turn) != 0) {
         if (gen_threats) {
-          moves.insert(target_pos);
+          if (visit(target_pos)) {
+            return true;
+          }
         }
         break;
       }
 
-      moves.insert(target_pos);
+      if (visit(target_pos)) {
+        return true;
+      }
 
       if ((m_squares[target_pos] &
            (m_turn == pieces::WHITE ? pieces::BLACK : pieces::WHITE)) != 0) {
@@ -118,86 +135,218 @@ chess::Board::generate_sliding_piece_moves(int from, bool gen_threats) const {
       }
     }
   }
-  return moves;
+  return false;
 }
 
-std::unordered_set<int>
-chess::Board::generate_king_moves(int from, bool gen_threats) const {
-  const int file = from % 8;
-  const int rank = from / 8;
-
-  std::unordered_set<int> moves;
-  constexpr std::array<std::array<int, 2>, 8> shifts = {
-      {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}}};
-  for (const auto [dy, dx] : shifts) {
-    if (0 <= rank + dy && rank + dy < 8 && 0 <= file + dx && file + dx < 8 &&
-        ((m_squares[(rank + dy) * 8 + file + dx] & m_turn) == 0 ||
-         gen_threats)) {
-      moves.insert((rank + dy) * 8 + file + dx);
+template <typename Visitor>
+bool chess::Board::visit_king_moves(int from, bool gen_threats,
+                                    Visitor &&visit) const {
+  for (auto targets = tables::king_attacks[from]; targets != 0;
+       targets &= targets - 1) {
+    const int to = std::countr_zero(targets);
+    if ((m_squares[to] & m_turn) == 0 || gen_threats) {
+      if (visit(to)) {
+        return true;
+      }
     }
   }
 
   if (m_kingside_castle[m_turn != pieces::BLACK] &&
       m_squares[from + 1] == pieces::NONE &&
-      m_squares[from + 2] == pieces::NONE && !m_checked_squares[from + 1] &&
-      !m_checked_squares[from + 2] &&
+      m_squares[from + 2] == pieces::NONE &&
+      (m_checked_squares &
+       (tables::bit(from + 1) | tables::bit(from + 2))) == 0 &&
       ((m_squares[from + 3] & ~m_turn) == pieces::ROOK) && !king_checked()) {
-    moves.insert(from + 2);
+    if (visit(from + 2)) {
+      return true;
+    }
   }
-  if (m_kingside_castle[m_turn != pieces::BLACK] &&
+  if (m_queenside_castle[m_turn != pieces::BLACK] &&
       m_squares[from - 1] == pieces::NONE &&
       m_squares[from - 2] == pieces::NONE &&
-      m_squares[from - 3] == pieces::NONE && !m_checked_squares[from - 1] &&
-      !m_checked_squares[from - 2] &&
-      ((m_squares[from + 3] & ~m_turn) == pieces::ROOK) && !king_checked()) {
-    moves.insert(from - 2);
+      m_squares[from - 3] == pieces::NONE &&
+      (m_checked_squares &
+       (tables::bit(from - 1) | tables::bit(from - 2))) == 0 &&
+      ((m_squares[from - 4] & ~m_turn) == pieces::ROOK) && !king_checked()) {
+    if (visit(from - 2)) {
+      return true;
+    }
   }
 
-  return moves;
+  return false;
 }
 
-std::unordered_set<int> chess::Board::generate_moves(int from,
-                                                     bool gen_threats) {
+template <typename Visitor>
+bool chess::Board::visit_moves(int from, bool gen_threats,
+                               Visitor &&visit) const {
   if ((m_squares[from] & m_turn) == 0) {
-    return {};
+    return false;
   }
 
-  std::unordered_set<int> possible_moves_candidates;
   switch (m_squares[from] & ~m_turn) {
   case pieces::PAWN:
-    possible_moves_candidates = generate_pawn_moves(from, gen_threats);
-    break;
+    return visit_pawn_moves(from, gen_threats, visit);
   case pieces::KNIGHT:
-    possible_moves_candidates = generate_knight_moves(from, gen_threats);
-    break;
+    return visit_knight_moves(from, gen_threats, visit);
   case pieces::BISHOP:
   case pieces::ROOK:
   case pieces::QUEEN:
-    possible_moves_candidates = generate_sliding_piece_moves(from, gen_threats);
-    break;
+    return visit_sliding_piece_moves(from, gen_threats, visit);
   case pieces::KING:
-    possible_moves_candidates = generate_king_moves(from, gen_threats);
-    break;
+    return visit_king_moves(from, gen_threats, visit);
   default:
     std::unreachable();
   }
+}
 
-  if (gen_threats) {
-    return possible_moves_candidates;
+bool chess::Board::square_attacked(int square, int by) const {
+  // a piece attacks the square if the same piece on the square would attack
+  // it back, pawns being the mirror image of the other color
+  const auto any_of = [this, square](std::uint64_t from, int piece) {
+    for (; from != 0; from &= from - 1) {
+      if (m_squares[std::countr_zero(from)] == piece) {
+        return true;
+      }
+    }
+    return false;
+  };
+  if (any_of(tables::pawn_attacks[by == pieces::BLACK][square],
+             by | pieces::PAWN) ||
+      any_of(tables::knight_attacks[square], by | pieces::KNIGHT) ||
+      any_of(tables::king_attacks[square], by | pieces::KING)) {
+    return true;
+  }
+
+  // first four directions are straight, last four are diagonal
+  for (int direction_index = 0; direction_index < 8; ++direction_index) {
+    const int slider = direction_index < 4 ? pieces::ROOK : pieces::BISHOP;
+    for (int i = 0; i < tables::squares_to_edge[square][direction_index]; ++i) {
+      const int target_pos =
+          square + tables::direction_offsets[direction_index] * (i + 1);
+      if (m_squares[target_pos] == pieces::NONE) {
+        continue;
+      }
+      if (m_squares[target_pos] == (by | slider) ||
+          m_squares[target_pos] == (by | pieces::QUEEN)) {
+        return true;
+      }
+      break;
+    }
+  }
+
+  return false;
+}
+
+bool chess::Board::is_legal(int from, int to) {
+  const int piece = m_squares[from];
+  const int captured = m_squares[to];
+  const int opponent = m_turn == pieces::WHITE ? pieces::BLACK : pieces::WHITE;
+
+  int en_passant_pos = -1;
+  if ((piece & ~m_turn) == pieces::PAWN && to == m_en_passant_target_square) {
+    en_passant_pos = m_turn == pieces::WHITE ? to + 8 : to - 8;
+  }
+
+  // nothing is uncovered when the piece does not shield the king from a
+  // line or keeps to that line; only the king and en passant (taking a
+  // second piece off a line) are always played out
+  const int own_king = m_king_pos[m_turn != pieces::BLACK];
+  if (!king_checked() && (piece & ~m_turn) != pieces::KING &&
+      en_passant_pos == -1) {
+    const auto line = tables::line[own_king][from];
+    if (line == 0 || (line & tables::bit(to)) != 0 ||
+        !empty_squares(tables::between[own_king][from])) {
+      return true;
+    }
   }
 
+  // play the move on the squares only, castling rook placement cannot
+  // affect safety of the own king
+  const int en_passant_pawn =
+      en_passant_pos != -1
+          ? std::exchange(m_squares[en_passant_pos], pieces::NONE)
+          : pieces::NONE;
+  m_squares[to] = std::exchange(m_squares[from], pieces::NONE);
+
+  const int king_pos = (piece & ~m_turn) == pieces::KING ? to : own_king;
+  const bool legal = !square_attacked(king_pos, opponent);
+
+  m_squares[from] = piece;
+  m_squares[to] = captured;
+  if (en_passant_pos != -1) {
+    m_squares[en_passant_pos] = en_passant_pawn;
+  }
+
+  if (!legal) {
+    STATS_INCREMENT(LEGALITY_REJECTIONS);
+    TraceLog(LOG_INFO, "Impossible move: %d %d", from, to);
+  }
+  return legal;
+}
+
+void chess::Board::fill_checked_squares() {
+  STATS_SCOPED_TIMER(CHECKED_SQUARES);
+  m_checked_squares = 0;
+  for (int pos = 0; pos < 64; ++pos) {
+    visit_moves(pos, true, [this](int square) {
+      m_checked_squares |= tables::bit(square);
+      return false;
+    });
+  }
+}
+
+const chess::MoveList &chess::Board::legal_moves() {
+  auto &entry = m_legal_moves[m_hash % m_legal_moves.size()];
+  if (!entry.valid || entry.hash != m_hash) {
+    STATS_SCOPED_TIMER(LEGAL_MOVES);
+    entry.moves.clear();
+    for (int from = 0; from < 64; ++from) {
+      visit_moves(from, false, [this, &entry, from](int to) {
+        if (is_legal(from, to)) {
+          entry.moves.push_back(
+              {static_cast<std::uint8_t>(from), static_cast<std::uint8_t>(to)});
+        }
+        return false;
+      });
+    }
+    entry.hash = m_hash;
+    entry.valid = true;
+  }
+  return entry.moves;
+}
+
+bool chess::Board::has_legal_move() {
+  const auto &entry = m_legal_moves[m_hash % m_legal_moves.size()];
+  if (entry.valid && entry.hash == m_hash) {
+    return !entry.moves.empty();
+  }
+
+  // stops on the first legal move, nothing is stored
+  STATS_SCOPED_TIMER(HAS_LEGAL_MOVE);
+  for (int from = 0; from < 64; ++from) {
+    if (visit_moves(from, false,
+                    [this, from](int to) { return is_legal(from, to); })) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::unordered_set<int> chess::Board::generate_moves(int from,
+                                                     bool gen_threats) {
   std::unordered_set<int> possible_moves;
-  for (int to : possible_moves_candidates) {
-    make_move(from, to);
-    fill_checked_squares();
-    toggle_turn();
-    if (!king_checked()) {
+  if (gen_threats) {
+    visit_moves(from, true, [&possible_moves](int to) {
       possible_moves.insert(to);
-    } else {
-      TraceLog(LOG_INFO, "Impossible move: %d %d", from, to);
-    }
-    unmake_move();
+      return false;
+    });
+    return possible_moves;
   }
 
+  for (const auto [move_from, move_to] : legal_moves()) {
+    if (move_from == from) {
+      possible_moves.insert(move_to);
+    }
+  }
   return possible_moves;
 }
@@ -0,0 +1,72 @@
+#ifndef JOB_HPP_
+#define JOB_HPP_
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <utility>
+
+namespace chess {
+
+// Runs one computation at a time on a background thread, so the render loop
+// never waits for it. The function receives a stop token it must poll for
+// cooperative cancellation and a progress value in [0, 1] it may update.
+template <typename T> class Job {
+public:
+  using Function = std::function<T(std::stop_token, std::atomic<float> &)>;
+
+  Job() = default;
+  ~Job() { cancel(); }
+  Job(const Job &other) = delete;
+  Job &operator=(const Job &other) = delete;
+  Job(Job &&other) = delete;
+  Job &operator=(Job &&other) = delete;
+
+  // Cancels the computation in flight (if any) and starts a new one.
+  void start(Function fn) {
+    cancel();
+    m_progress = 0.0f;
+    m_running = true;
+    m_thread = std::jthread([this, fn = std::move(fn)](std::stop_token token) {
+      T result = fn(token, m_progress);
+      if (!token.stop_requested()) {
+        std::lock_guard lock(m_mutex);
+        m_result = std::move(result);
+      }
+      m_running = false;
+    });
+  }
+
+  void cancel() {
+    if (m_thread.joinable()) {
+      m_thread.request_stop();
+      m_thread.join();
+    }
+    m_running = false;
+    std::lock_guard lock(m_mutex);
+    m_result.reset();
+  }
+
+  bool running() const { return m_running; }
+  float progress() const { return m_progress; }
+
+  // Returns the finished result once, then empties the slot.
+  std::optional<T> take() {
+    std::lock_guard lock(m_mutex);
+    return std::exchange(m_result, std::nullopt);
+  }
+
+private:
+  std::jthread m_thread;
+  std::mutex m_mutex;
+  std::optional<T> m_result;
+  std::atomic<bool> m_running = false;
+  std::atomic<float> m_progress = 0.0f;
+};
+
+} // namespace chess
+
+#endif // JOB_HPP_
@@ -1,4 +1,5 @@
 #include "game.hpp"
+#include "stats.hpp"
 #include <memory>
 #include <raylib-cpp.hpp>
 
@@ -9,12 +10,16 @@ int main() {
                         FLAG_MSAA_4X_HINT | FLAG_WINDOW_RESIZABLE);
   window.SetMinSize(chess::BOARD_WIDTH, chess::BOARD_HEIGHT);
   SetTargetFPS(chess::FPS);
+  chess::stats::install_report_signal();
 
   // TODO: position with possible promotion on next move. Do not only queen.
   [[maybe_unused]] constexpr std::string_view bug =
       "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q2/PPPBBPpP/R3K2R b kq - 1 1";
   auto game = std::make_unique<chess::Game>();
   while (!window.ShouldClose()) {
+    if (chess::stats::report_requested()) {
+      TraceLog(LOG_WARNING, "%s", chess::stats::report().c_str());
+    }
     window.BeginDrawing();
     game->draw_board();
     if (IsKeyPressed(KEY_ENTER)) {
@@ -27,4 +32,7 @@ int main() {
     }
     window.EndDrawing();
   }
+#ifdef CHESS_STATS
+  TraceLog(LOG_WARNING, "%s", chess::stats::report().c_str());
+#endif
 }
@@ -0,0 +1,236 @@
+#include "mate.hpp"
+#include "stats.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+
+namespace {
+
+// proof and disproof numbers saturate here, sums of them can not overflow
+constexpr std::uint32_t infinity = 1u << 28;
+
+std::uint32_t add(std::uint32_t lhs, std::uint32_t rhs) {
+  return std::min(infinity, lhs + rhs);
+}
+
+std::uint64_t node_key(const chess::Board &board, int plies) {
+  return board.hash() ^
+         static_cast<std::uint64_t>(plies) * 0x9e3779b97f4a7c15ull;
+}
+
+} // namespace
+
+chess::MateSearch::MateSearch(MateLimits limits)
+    : m_limits(limits),
+      m_table(std::bit_floor(std::max<std::size_t>(
+                  1, limits.memory_bytes / sizeof(Entry) / BUCKET_SIZE)) *
+              BUCKET_SIZE) {}
+
+bool chess::MateSearch::out_of_budget() {
+  if (m_aborted) {
+    return true;
+  }
+  if (m_limits.nodes != 0 && m_nodes >= m_limits.nodes) {
+    m_aborted = true;
+  } else if (m_nodes % 1024 == 0) {
+    using namespace std::chrono;
+    const auto elapsed = steady_clock::now() - m_start;
+    m_aborted = m_token.stop_requested() ||
+                (m_limits.time_ms != 0 &&
+                 elapsed >= milliseconds(m_limits.time_ms));
+  }
+  return m_aborted;
+}
+
+const chess::MateSearch::Entry *
+chess::MateSearch::find(std::uint64_t key) const {
+  const auto bucket = key & (m_table.size() / BUCKET_SIZE - 1);
+  for (std::size_t i = 0; i < BUCKET_SIZE; ++i) {
+    const auto &entry = m_table[bucket * BUCKET_SIZE + i];
+    if (entry.key == key) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+void chess::MateSearch::store(const Entry &entry) {
+  // entries of this run are kept over those of earlier ones
+  const auto worth = [this](const Entry &slot) {
+    return std::uint64_t{slot.generation == m_generation} << 32 | slot.work;
+  };
+  const auto bucket = entry.key & (m_table.size() / BUCKET_SIZE - 1);
+  Entry *victim = &m_table[bucket * BUCKET_SIZE];
+  for (std::size_t i = 0; i < BUCKET_SIZE; ++i) {
+    auto &slot = m_table[bucket * BUCKET_SIZE + i];
+    if (slot.key == entry.key) {
+      victim = &slot;
+      break;
+    }
+    if (worth(slot) < worth(*victim)) {
+      victim = &slot;
+    }
+  }
+  *victim = entry;
+  victim->generation = m_generation;
+}
+
+chess::MateSearch::Entry chess::MateSearch::evaluate(Board &board,
+                                                     int plies) {
+  const auto key = node_key(board, plies);
+  if (const auto *entry = find(key)) {
+    return *entry;
+  }
+
+  // the side to move reached its goal (phi 0) or failed (delta 0)
+  const Entry won{key, 0, infinity, 0};
+  const Entry lost{key, infinity, 0, 0};
+  const bool attacker = plies % 2 == 1;
+  if (!board.has_legal_move()) {
+    // only a mated defender loses, the attacker fails on a stalemate too
+    return attacker || board.king_checked() ? lost : won;
+  }
+  if (plies == 0) {
+    return won;
+  }
+  return {key, 1, 1, 0};
+}
+
+chess::MateSearch::Entry chess::MateSearch::mid(Board &board, int plies,
+                                                std::uint32_t phi_threshold,
+                                                std::uint32_t delta_threshold) {
+  ++m_nodes;
+  STATS_INCREMENT(NODES);
+  const auto start_nodes = m_nodes;
+
+  Entry node{node_key(board, plies), 1, 1, 0};
+  // a copy, the moves of other positions may take the place of the list
+  const MoveList moves = board.legal_moves();
+  std::array<Entry, MoveList::CAPACITY> children;
+  for (int i = 0; i < moves.size(); ++i) {
+    board.make_move(moves[i].from, moves[i].to);
+    children[i] = evaluate(board, plies - 1);
+    board.unmake_move();
+  }
+
+  while (!out_of_budget()) {
+    // phi is the least delta of a child, delta the sum of the children's phi
+    int best = 0;
+    std::uint32_t second_delta = infinity;
+    node.phi = infinity;
+    node.delta = 0;
+    for (int i = 0; i < moves.size(); ++i) {
+      node.delta = add(node.delta, children[i].phi);
+      if (children[i].delta < node.phi) {
+        second_delta = node.phi;
+        node.phi = children[i].delta;
+        best = i;
+      } else if (children[i].delta < second_delta) {
+        second_delta = children[i].delta;
+      }
+    }
+    if (node.phi >= phi_threshold || node.delta >= delta_threshold) {
+      break;
+    }
+
+    const auto child_phi_threshold =
+        delta_threshold - node.delta + children[best].phi;
+    const auto child_delta_threshold =
+        std::min(phi_threshold, add(second_delta, 1));
+    board.make_move(moves[best].from, moves[best].to);
+    children[best] = mid(board, plies - 1, child_phi_threshold,
+                         child_delta_threshold);
+    board.unmake_move();
+  }
+
+  node.work = static_cast<std::uint32_t>(
+      std::min<unsigned long long>(m_nodes - start_nodes + 1, infinity));
+  if (!m_aborted) {
+    store(node);
+  }
+  return node;
+}
+
+std::vector<chess::Move> chess::MateSearch::principal_line(Board &board,
+                                                           int plies) {
+  std::vector<Move> line;
+  for (; plies > 0 && !m_aborted; --plies) {
+    // a copy, the moves of other positions may take the place of the list
+    const MoveList moves = board.legal_moves();
+    if (moves.empty()) {
+      break;
+    }
+
+    const bool attacker = plies % 2 == 1;
+    int chosen = -1;
+    std::uint32_t most_work = 0;
+    // Proofs may have fallen out of the table since, the second pass
+    // searches the children again instead of trusting it.
+    for (int pass = 0; pass < 2 && chosen == -1; ++pass) {
+      for (int i = 0; i < moves.size() && !m_aborted; ++i) {
+        board.make_move(moves[i].from, moves[i].to);
+        auto child = evaluate(board, plies - 1);
+        const bool unresolved = child.phi != 0 && child.delta != 0;
+        if (unresolved && (pass == 1 || !attacker)) {
+          child = mid(board, plies - 1, infinity, infinity);
+        }
+        board.unmake_move();
+        if (attacker && child.delta == 0) {
+          chosen = i;
+          break;
+        }
+        // the defence that took the most work to refute
+        if (!attacker && (chosen == -1 || child.work > most_work)) {
+          chosen = i;
+          most_work = child.work;
+        }
+      }
+    }
+    if (chosen == -1) {
+      break;
+    }
+    line.push_back(moves[chosen]);
+    board.make_move(moves[chosen].from, moves[chosen].to);
+  }
+
+  for (std::size_t i = 0; i < line.size(); ++i) {
+    board.unmake_move();
+  }
+  return line;
+}
+
+chess::MateResult chess::MateSearch::run(Board &board, int moves,
+                                         std::stop_token token) {
+  m_token = token;
+  m_start = std::chrono::steady_clock::now();
+  m_nodes = 0;
+  m_aborted = false;
+  ++m_generation;
+
+  MateResult result;
+  result.status = MateResult::Status::DISPROVEN;
+  for (int length = 1; length <= moves; ++length) {
+    const int plies = 2 * length - 1;
+    auto root = evaluate(board, plies);
+    if (root.phi != 0 && root.delta != 0) {
+      root = mid(board, plies, infinity, infinity);
+    }
+    if (m_aborted) {
+      result.status = MateResult::Status::UNKNOWN;
+      break;
+    }
+    if (root.phi == 0) {
+      result.status = MateResult::Status::PROVEN;
+      result.moves = length;
+      result.line = principal_line(board, plies);
+      if (m_aborted) {
+        result.status = MateResult::Status::UNKNOWN;
+        result.line.clear();
+      }
+      break;
+    }
+  }
+
+  result.nodes = m_nodes;
+  return result;
+}
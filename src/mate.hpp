@@ -0,0 +1,80 @@
+#ifndef MATE_HPP_
+#define MATE_HPP_
+
+#include "board.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stop_token>
+#include <vector>
+
+namespace chess {
+
+struct MateLimits {
+  std::size_t memory_bytes = std::size_t{64} << 20; // node table size
+  unsigned long long nodes = 0; // per run, 0 means no limit
+  int time_ms = 0;              // per run, 0 means no limit
+};
+
+struct MateResult {
+  enum class Status { PROVEN, DISPROVEN, UNKNOWN };
+
+  Status status = Status::UNKNOWN;
+  int moves = 0;          // length of the proven mate
+  std::vector<Move> line; // attacker and defender moves up to the mate
+  unsigned long long nodes = 0;
+};
+
+// Depth-first proof-number search (df-pn) of "the side to move mates in at
+// most N moves". Mates of increasing length are tried in turn, so a proof
+// is of the shortest mate. Nodes live in a bounded table, entries of
+// earlier runs and then those that took the least work give way when it is
+// full, and positions that fell out of it are searched again. Repetitions
+// and the fifty-move rule are not considered, so the table stays valid
+// from one run to the next. Pawns only promote to queens like everywhere
+// else.
+class MateSearch {
+public:
+  explicit MateSearch(MateLimits limits = {});
+
+  MateResult run(Board &board, int moves, std::stop_token token = {});
+
+private:
+  struct Entry {
+    std::uint64_t key = 0;
+    // from the point of view of the side to move: phi is the cost of
+    // proving it reaches its goal (the mate or escaping it), delta of
+    // disproving that
+    std::uint32_t phi = 1;
+    std::uint32_t delta = 1;
+    std::uint32_t work = 0; // nodes searched below, for replacement
+    std::uint32_t generation = 0; // the run that stored it
+  };
+
+  static constexpr std::size_t BUCKET_SIZE = 4;
+
+  MateLimits m_limits;
+  std::vector<Entry> m_table;
+  std::uint32_t m_generation = 0;
+  std::stop_token m_token;
+  std::chrono::steady_clock::time_point m_start;
+  unsigned long long m_nodes = 0;
+  bool m_aborted = false;
+
+  // The attacker is to move when an odd number of plies is left.
+  // Positions are only looked up with the plies left to them, a position
+  // reached with more plies to go is a different node.
+  const Entry *find(std::uint64_t key) const;
+  void store(const Entry &entry);
+  // the entry of the board's position, terminal positions are resolved
+  Entry evaluate(Board &board, int plies);
+  // searches until the node's phi or delta reach the thresholds
+  Entry mid(Board &board, int plies, std::uint32_t phi_threshold,
+            std::uint32_t delta_threshold);
+  bool out_of_budget();
+  std::vector<Move> principal_line(Board &board, int plies);
+};
+
+} // namespace chess
+
+#endif // MATE_HPP_
@@ -0,0 +1,45 @@
+#ifndef MOVE_HPP_
+#define MOVE_HPP_
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+
+namespace chess {
+
+struct Move {
+  std::uint8_t from = 0;
+  std::uint8_t to = 0;
+};
+
+// Fixed capacity list. Positions reachable in a game have at most 218 legal
+// moves, the rest of the room is for made up positions with more pieces.
+// Being a plain array it is copied without allocations.
+class MoveList {
+public:
+  static constexpr int CAPACITY = 256;
+
+private:
+  std::array<Move, CAPACITY> m_moves;
+  int m_size = 0;
+
+public:
+  void push_back(Move move) {
+    assert(m_size < CAPACITY);
+    m_moves[m_size++] = move;
+  }
+  void clear() { m_size = 0; }
+
+  int size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+
+  const Move &operator[](int i) const { return m_moves[i]; }
+  const Move *begin() const { return m_moves.data(); }
+  const Move *end() const { return m_moves.data() + m_size; }
+  Move *begin() { return m_moves.data(); }
+  Move *end() { return m_moves.data() + m_size; }
+};
+
+} // namespace chess
+
+#endif // MOVE_HPP_
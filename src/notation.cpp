@@ -0,0 +1,76 @@
+#include "notation.hpp"
+
+std::string chess::square_name(int pos) {
+  return std::string{static_cast<char>('a' + pos % 8),
+                     static_cast<char>('0' + 8 - pos / 8)};
+}
+
+std::string chess::to_san(Board &board, Move move) {
+  using namespace pieces;
+
+  const int piece = board.square(move.from);
+  const int type = piece & 7;
+
+  std::string san;
+  if (type == KING && move.to - move.from == 2) {
+    san = "O-O";
+  } else if (type == KING && move.from - move.to == 2) {
+    san = "O-O-O";
+  } else {
+    const bool capture = board.square(move.to) != NONE ||
+                         (type == PAWN && move.from % 8 != move.to % 8);
+
+    if (type == PAWN) {
+      if (capture) {
+        san += static_cast<char>('a' + move.from % 8);
+      }
+    } else {
+      san += "?PNBRQK"[type];
+
+      // another piece of the same kind reaching the same square
+      bool ambiguous = false, same_file = false, same_rank = false;
+      for (const auto other : board.legal_moves()) {
+        if (other.to == move.to && other.from != move.from &&
+            board.square(other.from) == piece) {
+          ambiguous = true;
+          same_file = same_file || other.from % 8 == move.from % 8;
+          same_rank = same_rank || other.from / 8 == move.from / 8;
+        }
+      }
+      if (ambiguous && !same_file) {
+        san += static_cast<char>('a' + move.from % 8);
+      } else if (ambiguous && !same_rank) {
+        san += static_cast<char>('0' + 8 - move.from / 8);
+      } else if (ambiguous) {
+        san += square_name(move.from);
+      }
+    }
+
+    if (capture) {
+      san += 'x';
+    }
+    san += square_name(move.to);
+
+    // promotion (TODO: not only queen)
+    if (type == PAWN && (move.to / 8 == 0 || move.to / 8 == 7)) {
+      san += "=Q";
+    }
+  }
+
+  board.make_move(move.from, move.to);
+  if (board.king_checked()) {
+    san += board.has_legal_move() ? '+' : '#';
+  }
+  board.unmake_move();
+  return san;
+}
+
+std::string chess::to_coordinate(const Board &board, Move move) {
+  std::string result = square_name(move.from) + square_name(move.to);
+  // promotion (TODO: not only queen)
+  if ((board.square(move.from) & 7) == pieces::PAWN &&
+      (move.to / 8 == 0 || move.to / 8 == 7)) {
+    result += 'q';
+  }
+  return result;
+}
@@ -0,0 +1,21 @@
+#ifndef NOTATION_HPP_
+#define NOTATION_HPP_
+
+#include "board.hpp"
+#include <string>
+
+namespace chess {
+
+// "e4" for square 36
+std::string square_name(int pos);
+
+// standard algebraic notation of a legal move, e.g. "Nbd7", "exd5", "O-O",
+// "e8=Q+"; the board is used to disambiguate and to detect checks
+std::string to_san(Board &board, Move move);
+
+// coordinate notation as used by UCI, e.g. "e2e4", "e7e8q"
+std::string to_coordinate(const Board &board, Move move);
+
+} // namespace chess
+
+#endif // NOTATION_HPP_
@@ -0,0 +1,121 @@
+#include "pawns.hpp"
+#include "stats.hpp"
+#include <bit>
+
+namespace {
+
+using Bitboard = std::uint64_t;
+
+constexpr Bitboard file_a = 0x0101010101010101ull;
+constexpr Bitboard file_h = file_a << 7;
+
+constexpr int doubled_penalty = 12;
+constexpr int isolated_penalty = 12;
+constexpr int backward_penalty = 8;
+// by the number of ranks a passed pawn has advanced
+constexpr std::array<int, 8> passed_bonus = {0, 5, 10, 20, 35, 60, 100, 0};
+constexpr int shelter_near = 10;
+constexpr int shelter_far = 5;
+
+// rank 8 is at the low bits, so white pawns advance towards them
+Bitboard up_fill(Bitboard b) {
+  b |= b >> 8;
+  b |= b >> 16;
+  return b | b >> 32;
+}
+
+Bitboard down_fill(Bitboard b) {
+  b |= b << 8;
+  b |= b << 16;
+  return b | b << 32;
+}
+
+Bitboard sideways(Bitboard b) {
+  return ((b << 1) & ~file_a) | ((b >> 1) & ~file_h);
+}
+
+// Directions relative to the pawns of one color, 1 is white.
+Bitboard forward(Bitboard b, int color) { return color ? b >> 8 : b << 8; }
+Bitboard backward(Bitboard b, int color) { return color ? b << 8 : b >> 8; }
+Bitboard front_fill(Bitboard b, int color) {
+  return color ? up_fill(b) : down_fill(b);
+}
+
+Bitboard attacks(Bitboard pawns, int color) {
+  return color ? ((pawns >> 7) & ~file_a) | ((pawns >> 9) & ~file_h)
+               : ((pawns << 9) & ~file_a) | ((pawns << 7) & ~file_h);
+}
+
+// structure score of one color, positive is good for that color
+int structure(Bitboard own, Bitboard enemy, int color) {
+  const Bitboard files = up_fill(own) | down_fill(own);
+  const Bitboard isolated = own & ~sideways(files);
+  const Bitboard doubled = own & front_fill(forward(own, color), color);
+
+  // nothing in front on the same or a neighbouring file can stop it
+  const Bitboard enemy_front = front_fill(forward(enemy, !color), !color);
+  const Bitboard passed = own & ~(enemy_front | sideways(enemy_front));
+
+  // cannot be defended by a neighbour and cannot advance safely either
+  const Bitboard supportable = front_fill(sideways(own), color);
+  const Bitboard stop_attacked =
+      backward(forward(own, color) & attacks(enemy, !color), color);
+  const Bitboard backward_pawns =
+      own & ~supportable & ~isolated & stop_attacked;
+
+  int score = -doubled_penalty * std::popcount(doubled) -
+              isolated_penalty * std::popcount(isolated) -
+              backward_penalty * std::popcount(backward_pawns);
+  for (Bitboard rest = passed; rest != 0; rest &= rest - 1) {
+    const int rank = std::countr_zero(rest) / 8;
+    score += passed_bonus[color ? 7 - rank : rank];
+  }
+  return score;
+}
+
+} // namespace
+
+chess::PawnTable::PawnTable(std::size_t size)
+    : m_entries(std::bit_ceil(size)) {}
+
+chess::PawnEntry &chess::PawnTable::probe(const Board &board) {
+  STATS_INCREMENT(PAWN_HASH_PROBES);
+  // a table slot that was never written has key 0 and describes a position
+  // without pawns, which is exactly what such a position hashes to
+  const auto key = board.pawn_hash();
+  auto &entry = m_entries[key & (m_entries.size() - 1)];
+  if (entry.key == key) {
+    STATS_INCREMENT(PAWN_HASH_HITS);
+    return entry;
+  }
+
+  entry = {};
+  entry.key = key;
+  for (int pos = 0; pos < 64; ++pos) {
+    const int piece = board.square(pos);
+    if ((piece & 7) == pieces::PAWN) {
+      entry.pawns[(piece & pieces::WHITE) != 0] |= Bitboard{1} << pos;
+    }
+  }
+  for (int color = 0; color < 2; ++color) {
+    entry.attack_spans[color] =
+        front_fill(attacks(entry.pawns[color], color), color);
+  }
+  entry.score = structure(entry.pawns[1], entry.pawns[0], 1) -
+                structure(entry.pawns[0], entry.pawns[1], 0);
+  return entry;
+}
+
+int chess::PawnTable::shelter(PawnEntry &entry, int color, int king_pos) {
+  const int side = color != pieces::BLACK;
+  if (entry.shelter_king[side] != king_pos) {
+    const Bitboard near = forward(Bitboard{1} << king_pos, side);
+    const Bitboard zone = near | sideways(near);
+    const Bitboard pawns = entry.pawns[side];
+    entry.shelter[side] = static_cast<std::int16_t>(
+        shelter_near * std::popcount(pawns & zone) +
+        shelter_far * std::popcount(pawns & forward(zone, side)));
+    entry.shelter_king[side] = static_cast<std::int8_t>(king_pos);
+  }
+  return entry.shelter[side];
+}
@@ -0,0 +1,44 @@
+#ifndef PAWNS_HPP_
+#define PAWNS_HPP_
+
+#include "board.hpp"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace chess {
+
+// Pawn structure of a position, scores from white's point of view and
+// arrays indexed by color like in `Board` (0 is black, 1 is white).
+struct PawnEntry {
+  std::uint64_t key = 0;
+  std::array<std::uint64_t, 2> pawns = {0, 0};
+  // squares the pawns of a color attack now or may attack after advancing
+  std::array<std::uint64_t, 2> attack_spans = {0, 0};
+  int score = 0; // doubled, isolated, backward and passed pawns
+  // shelter in front of the king, for the king square it was computed for
+  std::array<std::int16_t, 2> shelter = {0, 0};
+  std::array<std::int8_t, 2> shelter_king = {-1, -1};
+};
+
+// Direct-mapped cache of pawn structure evaluations keyed by
+// `Board::pawn_hash`. Pawns move rarely compared to the other pieces, so
+// most evaluations in a search find their structure here.
+class PawnTable {
+public:
+  explicit PawnTable(std::size_t size = 1 << 13);
+
+  // the entry of the board's pawns, computed on a miss
+  PawnEntry &probe(const Board &board);
+
+  // pawns in front of `color`'s king on `king_pos`, cached in the entry
+  // until the king moves
+  static int shelter(PawnEntry &entry, int color, int king_pos);
+
+private:
+  std::vector<PawnEntry> m_entries;
+};
+
+} // namespace chess
+
+#endif // PAWNS_HPP_
@@ -0,0 +1,335 @@
+#include "search.hpp"
+#include "pawns.hpp"
+#include "stats.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+
+namespace {
+
+using namespace chess;
+
+constexpr std::array<int, 7> piece_values = {0, 100, 320, 330, 500, 900, 0};
+
+// Bonuses from white's point of view, index 0 is a8 like on the board.
+// Black pieces read the tables with the rank flipped.
+// clang-format off
+constexpr std::array<int, 64> pawn_table = {
+      0,   0,   0,   0,   0,   0,   0,   0,
+     50,  50,  50,  50,  50,  50,  50,  50,
+     10,  10,  20,  30,  30,  20,  10,  10,
+      5,   5,  10,  25,  25,  10,   5,   5,
+      0,   0,   0,  20,  20,   0,   0,   0,
+      5,  -5, -10,   0,   0, -10,  -5,   5,
+      5,  10,  10, -20, -20,  10,  10,   5,
+      0,   0,   0,   0,   0,   0,   0,   0,
+};
+
+constexpr std::array<int, 64> minor_table = {
+    -50, -40, -30, -30, -30, -30, -40, -50,
+    -40, -20,   0,   0,   0,   0, -20, -40,
+    -30,   0,  10,  15,  15,  10,   0, -30,
+    -30,   5,  15,  20,  20,  15,   5, -30,
+    -30,   0,  15,  20,  20,  15,   0, -30,
+    -30,   5,  10,  15,  15,  10,   5, -30,
+    -40, -20,   0,   5,   5,   0, -20, -40,
+    -50, -40, -30, -30, -30, -30, -40, -50,
+};
+
+constexpr std::array<int, 64> king_table = {
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -20, -30, -30, -40, -40, -30, -30, -20,
+    -10, -20, -20, -20, -20, -20, -20, -10,
+     20,  20,   0,   0,   0,   0,  20,  20,
+     20,  30,  10,   0,   0,  10,  30,  20,
+};
+// clang-format on
+
+// knights that no enemy pawn can ever attack, on ranks 3 to 5 for black
+// (first entry) and 4 to 6 for white
+constexpr int outpost_bonus = 15;
+constexpr std::array<std::uint64_t, 2> outpost_ranks = {0x0000ffffff000000ull,
+                                                        0x000000ffffff0000ull};
+
+int piece_square(int type, int pos) {
+  switch (type) {
+  case pieces::PAWN:
+    return pawn_table[pos];
+  case pieces::KNIGHT:
+  case pieces::BISHOP:
+    return minor_table[pos];
+  case pieces::KING:
+    return king_table[pos];
+  default:
+    return 0;
+  }
+}
+
+bool is_capture(const Board &board, Move move) {
+  return board.square(move.to) != pieces::NONE ||
+         ((board.square(move.from) & 7) == pieces::PAWN &&
+          move.from % 8 != move.to % 8);
+}
+
+// captures first, most valuable victim by least valuable attacker
+int move_order(const Board &board, Move move) {
+  if (!is_capture(board, move)) {
+    return 0;
+  }
+  const int victim = board.square(move.to) & 7;
+  const int attacker = board.square(move.from) & 7;
+  return 10 * piece_values[victim == pieces::NONE ? pieces::PAWN : victim] -
+         piece_values[attacker] + 10000;
+}
+
+void order_moves(const Board &board, MoveList &moves, Move first = {}) {
+  std::stable_sort(moves.begin(), moves.end(), [&](Move lhs, Move rhs) {
+    const bool lhs_first = lhs.from == first.from && lhs.to == first.to;
+    const bool rhs_first = rhs.from == first.from && rhs.to == first.to;
+    if (lhs_first != rhs_first) {
+      return lhs_first;
+    }
+    return move_order(board, lhs) > move_order(board, rhs);
+  });
+}
+
+// Mate scores count plies from the root, the cache keeps them counted from
+// the cached position so they stay right when it is reached by another path.
+int to_cache(int score, int ply) {
+  return Search::is_mate_score(score) ? score + (score > 0 ? ply : -ply)
+                                      : score;
+}
+
+int from_cache(int score, int ply) {
+  return Search::is_mate_score(score) ? score - (score > 0 ? ply : -ply)
+                                      : score;
+}
+
+} // namespace
+
+int chess::Search::evaluate(const Board &board) {
+  // one per thread, searches running in parallel never share entries
+  thread_local PawnTable pawn_table;
+
+  int score = 0;
+  std::array<int, 2> king_pos = {0, 0};
+  std::array<bool, 2> has_queen = {false, false};
+  std::array<std::uint64_t, 2> knights = {0, 0};
+  for (int pos = 0; pos < 64; ++pos) {
+    const int piece = board.square(pos);
+    if (piece == pieces::NONE) {
+      continue;
+    }
+    const int type = piece & 7;
+    const bool white = (piece & pieces::WHITE) != 0;
+    const int value =
+        piece_values[type] + piece_square(type, white ? pos : pos ^ 56);
+    score += white ? value : -value;
+
+    if (type == pieces::KING) {
+      king_pos[white] = pos;
+    } else if (type == pieces::QUEEN) {
+      has_queen[white] = true;
+    } else if (type == pieces::KNIGHT) {
+      knights[white] |= std::uint64_t{1} << pos;
+    }
+  }
+
+  auto &pawns = pawn_table.probe(board);
+  score += pawns.score;
+  for (int color = 0; color < 2; ++color) {
+    const int sign = color ? 1 : -1;
+    score += sign * outpost_bonus *
+             std::popcount(knights[color] & outpost_ranks[color] &
+                           ~pawns.attack_spans[!color]);
+    // a pawn shield only matters while there is a queen to attack with
+    if (has_queen[!color]) {
+      score += sign * PawnTable::shelter(
+                          pawns, color ? pieces::WHITE : pieces::BLACK,
+                          king_pos[color]);
+    }
+  }
+  return board.turn() == pieces::WHITE ? score : -score;
+}
+
+bool chess::Search::out_of_budget() {
+  if (m_aborted) {
+    return true;
+  }
+  if (m_limits.nodes != 0 && m_nodes >= m_limits.nodes) {
+    m_aborted = true;
+  } else if (m_nodes % 1024 == 0) {
+    using namespace std::chrono;
+    const auto elapsed = steady_clock::now() - m_start;
+    m_aborted = m_token.stop_requested() ||
+                (m_limits.time_ms != 0 &&
+                 elapsed >= milliseconds(m_limits.time_ms));
+  }
+  return m_aborted;
+}
+
+int chess::Search::quiescence(Board &board, int ply, int alpha, int beta) {
+  ++m_nodes;
+  STATS_INCREMENT(NODES);
+  if (out_of_budget()) {
+    return 0;
+  }
+
+  const int stand_pat = evaluate(board);
+  if (stand_pat >= beta || ply >= MAX_PLY) {
+    return stand_pat;
+  }
+  alpha = std::max(alpha, stand_pat);
+
+  MoveList moves = board.legal_moves();
+  order_moves(board, moves);
+  for (const auto move : moves) {
+    if (!is_capture(board, move)) {
+      break;
+    }
+    board.make_move(move.from, move.to);
+    const int score = -quiescence(board, ply + 1, -beta, -alpha);
+    board.unmake_move();
+    if (m_aborted) {
+      return 0;
+    }
+    if (score >= beta) {
+      return score;
+    }
+    alpha = std::max(alpha, score);
+  }
+  return alpha;
+}
+
+int chess::Search::negamax(Board &board, int depth, int ply, int alpha,
+                           int beta) {
+  if (depth <= 0) {
+    return quiescence(board, ply, alpha, beta);
+  }
+
+  ++m_nodes;
+  STATS_INCREMENT(NODES);
+  if (out_of_budget()) {
+    return 0;
+  }
+
+  MoveList moves = board.legal_moves();
+  if (moves.empty()) {
+    return board.king_checked() ? -MATE + ply : 0;
+  }
+  if (board.game_state() == Board::State::DRAW || ply >= MAX_PLY) {
+    return 0;
+  }
+
+  Move cached_move;
+  if (m_cache != nullptr) {
+    if (const auto entry = m_cache->probe(board.hash())) {
+      cached_move = entry->best_move;
+      const int score = from_cache(entry->score, ply);
+      if (entry->depth >= depth &&
+          (entry->bound == Bound::EXACT ||
+           (entry->bound == Bound::LOWER && score >= beta) ||
+           (entry->bound == Bound::UPPER && score <= alpha))) {
+        return score;
+      }
+    }
+  }
+
+  order_moves(board, moves, cached_move);
+  const int original_alpha = alpha;
+  int best = -MATE;
+  Move best_move = moves[0];
+  for (const auto move : moves) {
+    board.make_move(move.from, move.to);
+    const int score = -negamax(board, depth - 1, ply + 1, -beta, -alpha);
+    board.unmake_move();
+    if (m_aborted) {
+      return 0;
+    }
+    if (score > best) {
+      best = score;
+      best_move = move;
+    }
+    alpha = std::max(alpha, score);
+    if (alpha >= beta) {
+      break;
+    }
+  }
+
+  if (m_cache != nullptr) {
+    const Bound bound = best >= beta             ? Bound::LOWER
+                        : best > original_alpha ? Bound::EXACT
+                                                : Bound::UPPER;
+    m_cache->store(board.hash(),
+                   {best_move, to_cache(best, ply), depth, bound});
+  }
+  return best;
+}
+
+chess::SearchResult chess::Search::run(Board &board, std::stop_token token) {
+  m_token = token;
+  m_start = std::chrono::steady_clock::now();
+  m_nodes = 0;
+  m_aborted = false;
+
+  SearchResult result;
+  MoveList moves = board.legal_moves();
+  if (moves.empty()) {
+    return result;
+  }
+  result.best_move = moves[0];
+
+  // a result of an earlier session may already be deep enough
+  if (m_cache != nullptr) {
+    const auto entry = m_cache->probe(board.hash());
+    if (entry && entry->bound == Bound::EXACT &&
+        std::ranges::any_of(moves, [&](Move move) {
+          return move.from == entry->best_move.from &&
+                 move.to == entry->best_move.to;
+        })) {
+      result.best_move = entry->best_move;
+      // deepening stops at a mate score anyway
+      if (entry->depth >= m_limits.depth || is_mate_score(entry->score)) {
+        result.score = entry->score;
+        result.depth = entry->depth;
+        return result;
+      }
+    }
+  }
+
+  for (int depth = 1; depth <= m_limits.depth; ++depth) {
+    order_moves(board, moves, result.best_move);
+    Move best_move = moves[0];
+    int alpha = -MATE - 1;
+    for (const auto move : moves) {
+      board.make_move(move.from, move.to);
+      const int score = -negamax(board, depth - 1, 1, -MATE - 1, -alpha);
+      board.unmake_move();
+      if (m_aborted) {
+        break;
+      }
+      if (score > alpha) {
+        alpha = score;
+        best_move = move;
+      }
+    }
+    if (m_aborted) {
+      break;
+    }
+    result.best_move = best_move;
+    result.score = alpha;
+    result.depth = depth;
+    if (m_cache != nullptr) {
+      m_cache->store(board.hash(), {best_move, alpha, depth, Bound::EXACT});
+    }
+    if (is_mate_score(alpha)) {
+      break;
+    }
+  }
+
+  result.nodes = m_nodes;
+  return result;
+}
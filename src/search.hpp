@@ -0,0 +1,65 @@
+#ifndef SEARCH_HPP_
+#define SEARCH_HPP_
+
+#include "analysis_cache.hpp"
+#include "board.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <stop_token>
+
+namespace chess {
+
+struct SearchLimits {
+  int depth = 64;
+  unsigned long long nodes = 0; // 0 means no limit
+  int time_ms = 0;              // 0 means no limit
+};
+
+struct SearchResult {
+  Move best_move;
+  int score = 0; // centipawns from the side to move point of view
+  int depth = 0; // last fully searched depth
+  unsigned long long nodes = 0;
+};
+
+// Iterative deepening alpha-beta with a captures-only quiescence search.
+// The result of the last completed iteration is returned when the budget
+// runs out or a stop is requested. With a cache, results of earlier
+// searches cut the tree short and every finished node is written back.
+class Search {
+public:
+  static constexpr int MATE = 30000;
+  static constexpr int MAX_PLY = 128;
+  // Changes whenever evaluation or search give a position another score,
+  // results cached by another version are thrown away.
+  static constexpr std::uint32_t EVALUATION_VERSION = 1;
+
+  explicit Search(SearchLimits limits = {}, AnalysisCache *cache = nullptr)
+      : m_limits(limits), m_cache(cache) {}
+
+  SearchResult run(Board &board, std::stop_token token = {});
+
+  // static evaluation from the side to move point of view
+  static int evaluate(const Board &board);
+
+  static bool is_mate_score(int score) {
+    return std::abs(score) >= MATE - MAX_PLY;
+  }
+
+private:
+  SearchLimits m_limits;
+  AnalysisCache *m_cache;
+  std::stop_token m_token;
+  std::chrono::steady_clock::time_point m_start;
+  unsigned long long m_nodes = 0;
+  bool m_aborted = false;
+
+  int negamax(Board &board, int depth, int ply, int alpha, int beta);
+  int quiescence(Board &board, int ply, int alpha, int beta);
+  bool out_of_budget();
+};
+
+} // namespace chess
+
+#endif // SEARCH_HPP_
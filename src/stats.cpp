@@ -0,0 +1,168 @@
+#include "stats.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<bool> report_flag = false;
+
+void on_report_signal(int) { report_flag = true; }
+
+#ifdef CHESS_STATS
+
+constexpr std::array<const char *,
+                     static_cast<int>(chess::stats::Counter::COUNT)>
+    counter_names = {"nodes",           "make_move",
+                     "unmake_move",     "legality rejections",
+                     "hash probes",     "hash hits",
+                     "pawn hash probes", "pawn hash hits",
+                     "analysis cache probes", "analysis cache hits",
+                     "allocations"};
+
+constexpr std::array<const char *, static_cast<int>(chess::stats::Timer::COUNT)>
+    timer_names = {"legal_moves", "has_legal_move", "fill_checked_squares"};
+
+// Every thread takes a slot of its own on first use, so counting is an
+// uncontended atomic add on a cache line nobody else writes. Slots are
+// plain static storage: `operator new` counts through them too, so taking
+// one must not allocate. Past `max_threads` threads slots get shared,
+// which is still correct, only slower.
+constexpr int max_threads = 256;
+
+struct alignas(64) Slot {
+  std::array<std::atomic<std::uint64_t>,
+             static_cast<int>(chess::stats::Counter::COUNT)>
+      counters{};
+  std::array<std::atomic<std::uint64_t>,
+             static_cast<int>(chess::stats::Timer::COUNT)>
+      timer_calls{};
+  std::array<std::atomic<std::uint64_t>,
+             static_cast<int>(chess::stats::Timer::COUNT)>
+      timer_ns{};
+};
+
+std::array<Slot, max_threads> slots;
+std::atomic<int> slots_taken = 0;
+
+Slot &local_slot() {
+  thread_local Slot *slot = nullptr;
+  if (slot == nullptr) {
+    slot = &slots[slots_taken.fetch_add(1) % max_threads];
+  }
+  return *slot;
+}
+
+#endif // CHESS_STATS
+
+} // namespace
+
+#ifdef CHESS_STATS
+
+void chess::stats::add(Counter counter, std::uint64_t value) {
+  local_slot().counters[static_cast<int>(counter)].fetch_add(
+      value, std::memory_order_relaxed);
+}
+
+void chess::stats::add_time(Timer timer, std::uint64_t ns) {
+  auto &slot = local_slot();
+  slot.timer_calls[static_cast<int>(timer)].fetch_add(
+      1, std::memory_order_relaxed);
+  slot.timer_ns[static_cast<int>(timer)].fetch_add(ns,
+                                                   std::memory_order_relaxed);
+}
+
+// not inlined, otherwise gcc pairs the inlined `malloc` and `free` with
+// library `new` and `delete` and warns about a mismatch
+[[gnu::noinline]] void *operator new(std::size_t size) {
+  STATS_INCREMENT(ALLOCATIONS);
+  if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void *ptr) noexcept { std::free(ptr); }
+[[gnu::noinline]] void operator delete(void *ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+#endif // CHESS_STATS
+
+chess::stats::Snapshot chess::stats::snapshot() {
+  Snapshot result;
+#ifdef CHESS_STATS
+  const int used = std::min(slots_taken.load(), max_threads);
+  for (int i = 0; i < used; ++i) {
+    for (int j = 0; j < static_cast<int>(Counter::COUNT); ++j) {
+      result.counters[j] += slots[i].counters[j].load();
+    }
+    for (int j = 0; j < static_cast<int>(Timer::COUNT); ++j) {
+      result.timer_calls[j] += slots[i].timer_calls[j].load();
+      result.timer_ns[j] += slots[i].timer_ns[j].load();
+    }
+  }
+#endif // CHESS_STATS
+  return result;
+}
+
+void chess::stats::reset() {
+#ifdef CHESS_STATS
+  for (auto &slot : slots) {
+    for (auto &counter : slot.counters) {
+      counter = 0;
+    }
+    for (int j = 0; j < static_cast<int>(Timer::COUNT); ++j) {
+      slot.timer_calls[j] = 0;
+      slot.timer_ns[j] = 0;
+    }
+  }
+#endif // CHESS_STATS
+}
+
+std::string
+chess::stats::report([[maybe_unused]] const Snapshot &snapshot) {
+#ifndef CHESS_STATS
+  return "statistics are compiled out, configure with -DCHESS_STATS=ON";
+#else
+  std::string result = "statistics:";
+  char line[128];
+  for (int i = 0; i < static_cast<int>(Counter::COUNT); ++i) {
+    std::snprintf(line, sizeof(line), "\n  %-22s %14llu", counter_names[i],
+                  static_cast<unsigned long long>(snapshot.counters[i]));
+    result += line;
+  }
+  const auto hit_rate = [&](const char *name, Counter probes, Counter hits) {
+    std::snprintf(line, sizeof(line), "\n  %-22s %13.1f%%", name,
+                  snapshot[probes] == 0
+                      ? 0.0
+                      : 100.0 * snapshot[hits] / snapshot[probes]);
+    result += line;
+  };
+  hit_rate("hash hit rate", Counter::HASH_PROBES, Counter::HASH_HITS);
+  hit_rate("pawn hash hit rate", Counter::PAWN_HASH_PROBES,
+           Counter::PAWN_HASH_HITS);
+  hit_rate("analysis hit rate", Counter::ANALYSIS_CACHE_PROBES,
+           Counter::ANALYSIS_CACHE_HITS);
+  for (int i = 0; i < static_cast<int>(Timer::COUNT); ++i) {
+    const auto calls = snapshot.timer_calls[i];
+    std::snprintf(line, sizeof(line),
+                  "\n  %-22s %14llu calls %10.3f ms %10.1f ns/call",
+                  timer_names[i], static_cast<unsigned long long>(calls),
+                  snapshot.timer_ns[i] / 1e6,
+                  calls == 0 ? 0.0
+                             : static_cast<double>(snapshot.timer_ns[i]) /
+                                   calls);
+    result += line;
+  }
+  return result;
+#endif // CHESS_STATS
+}
+
+void chess::stats::install_report_signal(int signal) {
+  std::signal(signal, on_report_signal);
+}
+
+bool chess::stats::report_requested() { return report_flag.exchange(false); }
@@ -0,0 +1,95 @@
+#ifndef STATS_HPP_
+#define STATS_HPP_
+
+#include <array>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <string>
+
+// Hot path instrumentation, enabled by configuring with -DCHESS_STATS=ON.
+// Otherwise the macros below expand to nothing and only the reporting
+// functions remain, returning empty snapshots. Reports nobody asked for
+// (after a perft, at exit) are only printed by instrumented builds.
+
+namespace chess::stats {
+
+enum class Counter {
+  NODES,
+  MAKE_MOVE,
+  UNMAKE_MOVE,
+  LEGALITY_REJECTIONS,
+  HASH_PROBES,
+  HASH_HITS,
+  PAWN_HASH_PROBES,
+  PAWN_HASH_HITS,
+  ANALYSIS_CACHE_PROBES,
+  ANALYSIS_CACHE_HITS,
+  ALLOCATIONS,
+  COUNT
+};
+
+enum class Timer { LEGAL_MOVES, HAS_LEGAL_MOVE, CHECKED_SQUARES, COUNT };
+
+struct Snapshot {
+  std::array<std::uint64_t, static_cast<int>(Counter::COUNT)> counters{};
+  std::array<std::uint64_t, static_cast<int>(Timer::COUNT)> timer_calls{};
+  std::array<std::uint64_t, static_cast<int>(Timer::COUNT)> timer_ns{};
+
+  std::uint64_t operator[](Counter counter) const {
+    return counters[static_cast<int>(counter)];
+  }
+};
+
+// Sums the counters of all threads that ever recorded anything.
+Snapshot snapshot();
+void reset();
+std::string report(const Snapshot &snapshot = stats::snapshot());
+
+// Makes `signal` request a report, the handler only sets a flag which is
+// polled (and cleared) by `report_requested` from a safe place.
+void install_report_signal(int signal = SIGUSR1);
+bool report_requested();
+
+#ifdef CHESS_STATS
+
+void add(Counter counter, std::uint64_t value = 1);
+void add_time(Timer timer, std::uint64_t ns);
+
+class ScopedTimer {
+private:
+  Timer m_timer;
+  std::chrono::steady_clock::time_point m_start =
+      std::chrono::steady_clock::now();
+
+public:
+  explicit ScopedTimer(Timer timer) : m_timer(timer) {}
+  ~ScopedTimer() {
+    add_time(m_timer, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - m_start)
+                          .count());
+  }
+  ScopedTimer(const ScopedTimer &other) = delete;
+  ScopedTimer &operator=(const ScopedTimer &other) = delete;
+  ScopedTimer(ScopedTimer &&other) = delete;
+  ScopedTimer &operator=(ScopedTimer &&other) = delete;
+};
+
+#define STATS_ADD(counter, value)                                              \
+  ::chess::stats::add(::chess::stats::Counter::counter, (value))
+#define STATS_INCREMENT(counter) STATS_ADD(counter, 1)
+#define STATS_SCOPED_TIMER(timer)                                              \
+  ::chess::stats::ScopedTimer stats_scoped_timer_##timer(                      \
+      ::chess::stats::Timer::timer)
+
+#else
+
+#define STATS_ADD(counter, value) static_cast<void>(0)
+#define STATS_INCREMENT(counter) static_cast<void>(0)
+#define STATS_SCOPED_TIMER(timer) static_cast<void>(0)
+
+#endif // CHESS_STATS
+
+} // namespace chess::stats
+
+#endif // STATS_HPP_
@@ -0,0 +1,181 @@
+#ifndef TABLES_HPP_
+#define TABLES_HPP_
+
+#include "pieces.hpp"
+#include <array>
+#include <bit>
+#include <cstdint>
+
+// Board geometry and hash keys, all computed at compile time. Square 0 is a8
+// and square 63 is h1, as in `Board`.
+
+namespace chess::tables {
+
+using Bitboard = std::uint64_t;
+
+constexpr Bitboard bit(int pos) { return Bitboard{1} << pos; }
+
+// up, down, left, right, then the diagonals; first four are straight
+inline constexpr std::array<int, 8> direction_offsets = {-8, 8, -1, 1,
+                                                         -7, 7, 9,  -9};
+
+// squares from every square to the edge of the board in each direction
+inline constexpr auto squares_to_edge = [] {
+  std::array<std::array<int, 8>, 64> result{};
+  for (int rank = 0; rank < 8; ++rank) {
+    for (int file = 0; file < 8; ++file) {
+      const int num_up = rank;
+      const int num_down = 7 - rank;
+      const int num_left = file;
+      const int num_right = 7 - file;
+
+      auto &edges = result[rank * 8 + file];
+      edges[0] = num_up;
+      edges[1] = num_down;
+      edges[2] = num_left;
+      edges[3] = num_right;
+      edges[4] = num_up < num_right ? num_up : num_right;
+      edges[5] = num_down < num_left ? num_down : num_left;
+      edges[6] = num_down < num_right ? num_down : num_right;
+      edges[7] = num_up < num_left ? num_up : num_left;
+    }
+  }
+  return result;
+}();
+
+namespace detail {
+
+using Shifts = std::array<std::array<int, 2>, 8>;
+
+// {rank, file} steps of the pieces that jump to a fixed set of squares
+inline constexpr Shifts knight_shifts = {
+    {{-2, -1}, {-2, 1}, {-1, 2}, {1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}}};
+inline constexpr Shifts king_shifts = {
+    {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}}};
+
+constexpr std::array<Bitboard, 64> leaper_attacks(const Shifts &shifts) {
+  std::array<Bitboard, 64> result{};
+  for (int pos = 0; pos < 64; ++pos) {
+    for (const auto [dy, dx] : shifts) {
+      const int rank = pos / 8 + dy;
+      const int file = pos % 8 + dx;
+      if (0 <= rank && rank < 8 && 0 <= file && file < 8) {
+        result[pos] |= bit(rank * 8 + file);
+      }
+    }
+  }
+  return result;
+}
+
+// squares passed by the ray from `from` in the direction, edge included
+constexpr Bitboard ray(int from, int direction) {
+  Bitboard result = 0;
+  for (int i = 1; i <= squares_to_edge[from][direction]; ++i) {
+    result |= bit(from + direction_offsets[direction] * i);
+  }
+  return result;
+}
+
+} // namespace detail
+
+inline constexpr auto knight_attacks =
+    detail::leaper_attacks(detail::knight_shifts);
+inline constexpr auto king_attacks =
+    detail::leaper_attacks(detail::king_shifts);
+
+// [color][square], color 0 is black and 1 is white; white pawns attack
+// towards rank 8
+inline constexpr auto pawn_attacks = [] {
+  std::array<std::array<Bitboard, 64>, 2> result{};
+  for (int pos = 0; pos < 64; ++pos) {
+    const int file = pos % 8;
+    if (pos >= 8) {
+      result[1][pos] = (file != 0 ? bit(pos - 9) : 0) |
+                       (file != 7 ? bit(pos - 7) : 0);
+    }
+    if (pos < 56) {
+      result[0][pos] = (file != 0 ? bit(pos + 7) : 0) |
+                       (file != 7 ? bit(pos + 9) : 0);
+    }
+  }
+  return result;
+}();
+
+// squares strictly between two squares on a common line, empty otherwise
+inline constexpr auto between = [] {
+  std::array<std::array<Bitboard, 64>, 64> result{};
+  for (int from = 0; from < 64; ++from) {
+    for (int direction = 0; direction < 8; ++direction) {
+      Bitboard passed = 0;
+      for (int i = 1; i <= squares_to_edge[from][direction]; ++i) {
+        const int to = from + direction_offsets[direction] * i;
+        result[from][to] = passed;
+        passed |= bit(to);
+      }
+    }
+  }
+  return result;
+}();
+
+// the whole line through two squares, empty if they are not on one
+inline constexpr auto line = [] {
+  std::array<std::array<Bitboard, 64>, 64> result{};
+  for (int from = 0; from < 64; ++from) {
+    // opposite directions are neighbours in `direction_offsets`
+    for (int direction = 0; direction < 8; direction += 2) {
+      const Bitboard full = detail::ray(from, direction) |
+                            detail::ray(from, direction + 1) | bit(from);
+      for (Bitboard rest = full & ~bit(from); rest != 0; rest &= rest - 1) {
+        result[from][std::countr_zero(rest)] = full;
+      }
+    }
+  }
+  return result;
+}();
+
+} // namespace chess::tables
+
+namespace chess::zobrist {
+
+struct Keys {
+  // [piece][square], zero for codes that are not a piece so that an empty
+  // square hashes to nothing
+  std::array<std::array<std::uint64_t, 64>, 24> pieces{};
+  // by castling rights, bits K, Q, k, q from the lowest
+  std::array<std::uint64_t, 16> castling{};
+  // by file of the en passant target square
+  std::array<std::uint64_t, 8> en_passant{};
+  std::uint64_t black_to_move = 0;
+};
+
+inline constexpr Keys keys = [] {
+  // splitmix64, fixed seed so hashes are stable between runs
+  std::uint64_t state = 0x9e3779b97f4a7c15ull;
+  const auto next = [&state] {
+    std::uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  };
+
+  Keys result;
+  for (const int color : {pieces::WHITE, pieces::BLACK}) {
+    for (int type = pieces::PAWN; type <= pieces::KING; ++type) {
+      for (auto &key : result.pieces[color | type]) {
+        key = next();
+      }
+    }
+  }
+  for (auto &key : result.castling) {
+    key = next();
+  }
+  for (auto &key : result.en_passant) {
+    key = next();
+  }
+  result.black_to_move = next();
+  return result;
+}();
+
+} // namespace chess::zobrist
+
+#endif // TABLES_HPP_
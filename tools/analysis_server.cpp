@@ -0,0 +1,770 @@
+#include "analysis_cache.hpp"
+#include "batch.hpp"
+#include "board.hpp"
+#include "notation.hpp"
+#include "search.hpp"
+#include "stats.hpp"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Serves analysis to local clients over a Unix domain socket (default) or
+// TCP on 127.0.0.1. Every request is one line and gets one response line,
+// in request order per connection; clients may pipeline.
+//
+//   moves <fen>                -> ok e2e4 g1f3 ...   (coordinate notation)
+//   state <fen>                -> ok playing | ok mate | ok draw
+//   best depth <plies> <fen>   -> ok <move> score <cp> depth <plies>
+//   best nodes <count> <fen>      nodes <count>      (or "ok none")
+//   stats                      -> ok queries <n> batches <n> ...
+//
+// Malformed requests get "error <reason>". The game state queries that
+// arrive in one round of the event loop, from any connection, are queued
+// in batches of up to --batch and answered together by `analyse_batch`, so
+// nothing waits for a batch to fill up. Move lists and searches are queued
+// one by one and spread over the worker pool. Workers share a cache of
+// results keyed by the position hash and the request, and a query whose
+// answer is already being computed waits for it instead of computing it
+// again. Searches whose clients all went away are stopped. Searches may
+// also share a persistent `AnalysisCache` with other sessions.
+//
+// usage: analysis_server [--socket <path> | --port <port>]
+//                        [--threads <count>] [--batch <queries>]
+//                        [--cache <entries>] [--analysis-cache <path>]
+
+namespace {
+
+using namespace chess;
+
+struct Options {
+  std::string socket_path = "chess.sock";
+  int port = 0; // TCP instead of the Unix socket when set
+  int threads = static_cast<int>(
+      std::max(1u, std::thread::hardware_concurrency()));
+  std::size_t batch = 64;
+  std::size_t cache = 1 << 16;
+  std::string analysis_cache_path; // none when empty
+};
+
+constexpr std::size_t max_line = 4096;
+
+enum class Kind { MOVES, STATE, BEST };
+
+struct Query {
+  Kind kind = Kind::MOVES;
+  std::string fen;
+  SearchLimits limits;
+  std::string response; // written by a worker before `done` is set
+  std::atomic<bool> done = false;
+  std::atomic<bool> cancelled = false; // the client went away
+  std::optional<std::uint64_t> key;    // guarded by the `InFlight` mutex
+};
+
+using Batch = std::vector<std::shared_ptr<Query>>;
+
+struct Counters {
+  std::atomic<unsigned long long> queries = 0;
+  std::atomic<unsigned long long> batches = 0;
+  std::atomic<unsigned long long> cache_probes = 0;
+  std::atomic<unsigned long long> cache_hits = 0;
+};
+
+// Direct-mapped and always replacing; a stripe of mutexes keeps workers on
+// different entries from waiting for each other.
+class Cache {
+public:
+  explicit Cache(std::size_t size) : m_entries(std::bit_ceil(size)) {}
+
+  bool find(std::uint64_t key, std::string &response) {
+    auto &entry = m_entries[key & (m_entries.size() - 1)];
+    std::lock_guard lock(m_mutexes[key % m_mutexes.size()]);
+    if (entry.key != key || entry.response.empty()) {
+      return false;
+    }
+    response = entry.response;
+    return true;
+  }
+
+  void store(std::uint64_t key, const std::string &response) {
+    auto &entry = m_entries[key & (m_entries.size() - 1)];
+    std::lock_guard lock(m_mutexes[key % m_mutexes.size()]);
+    entry.key = key;
+    entry.response = response;
+  }
+
+private:
+  struct Entry {
+    std::uint64_t key = 0;
+    std::string response;
+  };
+
+  std::vector<Entry> m_entries;
+  std::array<std::mutex, 64> m_mutexes;
+};
+
+// Queries being answered, by cache key. The first query of a key computes
+// the answer for every query of that key that arrives meanwhile, and its
+// search is stopped once all of them are cancelled.
+class InFlight {
+public:
+  struct Group {
+    std::vector<std::shared_ptr<Query>> queries;
+    std::stop_source stop;
+  };
+
+  // The group the caller has to compute the answer for, or nullptr when
+  // the query joined a group another worker computes.
+  std::shared_ptr<Group> begin(std::uint64_t key,
+                               const std::shared_ptr<Query> &query) {
+    std::lock_guard lock(m_mutex);
+    query->key = key;
+    auto &group = m_groups[key];
+    // a stopped search does not answer anyone, start over
+    if (group != nullptr && !group->stop.stop_requested()) {
+      group->queries.push_back(query);
+      return nullptr;
+    }
+    group = std::make_shared<Group>();
+    group->queries.push_back(query);
+    if (query->cancelled) {
+      group->stop.request_stop();
+    }
+    return group;
+  }
+
+  // every query of the group, the answer is theirs
+  std::vector<std::shared_ptr<Query>> end(const std::shared_ptr<Group> &group) {
+    std::lock_guard lock(m_mutex);
+    const auto it = m_groups.find(*group->queries.front()->key);
+    if (it != m_groups.end() && it->second == group) {
+      m_groups.erase(it);
+    }
+    return std::move(group->queries);
+  }
+
+  void cancel(Query &query) {
+    std::lock_guard lock(m_mutex);
+    query.cancelled = true;
+    if (!query.key) {
+      return; // not started, the worker skips it
+    }
+    const auto it = m_groups.find(*query.key);
+    if (it == m_groups.end()) {
+      return;
+    }
+    const auto &queries = it->second->queries;
+    const auto is_query = [&](const auto &other) {
+      return other.get() == &query;
+    };
+    const auto is_cancelled = [](const auto &other) {
+      return other->cancelled.load();
+    };
+    if (std::ranges::any_of(queries, is_query) &&
+        std::ranges::all_of(queries, is_cancelled)) {
+      it->second->stop.request_stop();
+    }
+  }
+
+private:
+  std::mutex m_mutex;
+  std::unordered_map<std::uint64_t, std::shared_ptr<Group>> m_groups;
+};
+
+class BatchQueue {
+public:
+  void push(Batch batch) {
+    {
+      std::lock_guard lock(m_mutex);
+      m_batches.push_back(std::move(batch));
+    }
+    m_condition.notify_one();
+  }
+
+  std::optional<Batch> pop(std::stop_token token) {
+    std::unique_lock lock(m_mutex);
+    if (!m_condition.wait(lock, token, [&] { return !m_batches.empty(); })) {
+      return std::nullopt;
+    }
+    auto batch = std::move(m_batches.front());
+    m_batches.pop_front();
+    return batch;
+  }
+
+private:
+  std::mutex m_mutex;
+  std::condition_variable_any m_condition;
+  std::deque<Batch> m_batches;
+};
+
+// Wakes the event loop when workers finish queries, through a pipe it polls.
+// Wake-ups are coalesced until the loop has drained the pipe.
+class Waker {
+public:
+  Waker() {
+    if (::pipe(m_fds.data()) == 0) {
+      ::fcntl(m_fds[0], F_SETFL, O_NONBLOCK);
+      ::fcntl(m_fds[1], F_SETFL, O_NONBLOCK);
+    }
+  }
+  ~Waker() {
+    ::close(m_fds[0]);
+    ::close(m_fds[1]);
+  }
+  Waker(const Waker &other) = delete;
+  Waker &operator=(const Waker &other) = delete;
+
+  int fd() const { return m_fds[0]; }
+
+  void wake() {
+    if (!m_pending.exchange(true)) {
+      const char byte = 0;
+      [[maybe_unused]] const auto written = ::write(m_fds[1], &byte, 1);
+    }
+  }
+
+  void drain() {
+    m_pending = false;
+    char buffer[64];
+    while (::read(m_fds[0], buffer, sizeof(buffer)) > 0) {
+    }
+  }
+
+private:
+  std::array<int, 2> m_fds = {-1, -1};
+  std::atomic<bool> m_pending = false;
+};
+
+// The hash covers the position only, the 50-move rule and the request are
+// mixed in so that different questions about it do not share an entry.
+std::uint64_t cache_key(const Board &board, const Query &query) {
+  std::uint64_t request = static_cast<std::uint64_t>(query.kind) |
+                          (board.halfmove_clock() >= 100 ? 4u : 0u);
+  if (query.kind == Kind::BEST) {
+    request |= static_cast<std::uint64_t>(query.limits.depth) << 3 |
+               static_cast<std::uint64_t>(query.limits.nodes) << 16;
+  }
+  // splitmix64 finalizer
+  request = (request ^ (request >> 30)) * 0xbf58476d1ce4e5b9ull;
+  request = (request ^ (request >> 27)) * 0x94d049bb133111ebull;
+  return board.hash() ^ request ^ (request >> 31);
+}
+
+// Boards push themselves onto the history of the thread, which only grows
+// here; start it over with every position.
+Board load(const std::string &fen) {
+  Board board(fen);
+  board.history() = {};
+  board.history().push(board);
+  return board;
+}
+
+std::string moves_response(Board &board) {
+  std::string response = "ok";
+  for (const auto move : board.legal_moves()) {
+    response += ' ';
+    response += to_coordinate(board, move);
+  }
+  return response;
+}
+
+std::string best_response(Board &board, const SearchLimits &limits,
+                          AnalysisCache *analysis, std::stop_token token) {
+  const auto result = Search(limits, analysis).run(board, token);
+  if (result.depth == 0 && board.legal_moves().empty()) {
+    return "ok none";
+  }
+  return "ok " + to_coordinate(board, result.best_move) + " score " +
+         std::to_string(result.score) + " depth " +
+         std::to_string(result.depth) + " nodes " +
+         std::to_string(result.nodes);
+}
+
+// what the event loop and the workers share
+struct Shared {
+  Shared(std::size_t cache_size, AnalysisCache *analysis)
+      : cache(cache_size), analysis(analysis) {}
+
+  Cache cache;
+  InFlight in_flight;
+  AnalysisCache *analysis;
+  Counters counters;
+  Waker waker;
+};
+
+bool cached(Query &query, std::uint64_t key, Shared &shared) {
+  ++shared.counters.cache_probes;
+  STATS_INCREMENT(HASH_PROBES);
+  if (!shared.cache.find(key, query.response)) {
+    return false;
+  }
+  ++shared.counters.cache_hits;
+  STATS_INCREMENT(HASH_HITS);
+  query.done.store(true, std::memory_order_release);
+  shared.waker.wake();
+  return true;
+}
+
+// Game states of a whole batch in one go, each position once.
+void process_states(Batch &batch, Shared &shared) {
+  BoardBatch states;
+  std::vector<std::uint64_t> keys;
+  std::vector<std::vector<Query *>> queries; // by position in `states`
+  std::unordered_map<std::uint64_t, std::size_t> index;
+  for (auto &query : batch) {
+    if (query->cancelled) {
+      continue;
+    }
+    const Board board = load(query->fen);
+    const auto key = cache_key(board, *query);
+    if (cached(*query, key, shared)) {
+      continue;
+    }
+    // the 50-move rule comes first, like in `Board::game_state`
+    if (board.halfmove_clock() >= 100) {
+      query->response = "ok draw";
+      shared.cache.store(key, query->response);
+      query->done.store(true, std::memory_order_release);
+      shared.waker.wake();
+      continue;
+    }
+    const auto [it, inserted] = index.try_emplace(key, states.size());
+    if (inserted) {
+      states.push_back(board);
+      keys.push_back(key);
+      queries.emplace_back();
+    }
+    queries[it->second].push_back(query.get());
+  }
+  if (keys.empty()) {
+    return;
+  }
+
+  BatchResult result;
+  analyse_batch(states, result);
+  for (std::size_t i = 0; i < states.size(); ++i) {
+    const char *response = result.legal_moves[i] != 0 ? "ok playing"
+                           : result.in_check[i] != 0  ? "ok mate"
+                                                      : "ok draw";
+    shared.cache.store(keys[i], response);
+    for (auto *query : queries[i]) {
+      query->response = response;
+      query->done.store(true, std::memory_order_release);
+    }
+  }
+  shared.waker.wake();
+}
+
+// A move list or a search, computed once for all queries asking the same.
+void process_query(const std::shared_ptr<Query> &query, Shared &shared,
+                   std::stop_token token) {
+  if (query->cancelled) {
+    return;
+  }
+  Board board = load(query->fen);
+  const auto key = cache_key(board, *query);
+  if (cached(*query, key, shared)) {
+    return;
+  }
+  const auto group = shared.in_flight.begin(key, query);
+  if (group == nullptr) {
+    return;
+  }
+
+  std::string response;
+  {
+    std::stop_callback shutdown(token, [&] { group->stop.request_stop(); });
+    response = query->kind == Kind::MOVES
+                   ? moves_response(board)
+                   : best_response(board, query->limits, shared.analysis,
+                                   group->stop.get_token());
+  }
+  // a stopped search may be cut short, it is not worth keeping
+  if (!group->stop.stop_requested()) {
+    shared.cache.store(key, response);
+  }
+  for (const auto &waiting : shared.in_flight.end(group)) {
+    waiting->response = response;
+    waiting->done.store(true, std::memory_order_release);
+  }
+  shared.waker.wake();
+}
+
+void process(Batch &batch, Shared &shared, std::stop_token token) {
+  if (batch.front()->kind == Kind::STATE) {
+    process_states(batch, shared);
+    return;
+  }
+  for (const auto &query : batch) {
+    process_query(query, shared, token);
+  }
+}
+
+// Parses a request line. Requests that need no worker, and malformed ones,
+// come back done.
+std::shared_ptr<Query> parse_request(std::string_view line,
+                                     const Counters &counters) {
+  auto query = std::make_shared<Query>();
+  const auto done = [&](std::string response) {
+    query->response = std::move(response);
+    query->done = true;
+    return query;
+  };
+
+  const auto word = [&line]() {
+    const auto start = line.find_first_not_of(' ');
+    if (start == std::string_view::npos) {
+      line = {};
+      return std::string_view{};
+    }
+    const auto end = std::min(line.find(' ', start), line.size());
+    const auto result = line.substr(start, end - start);
+    line.remove_prefix(end);
+    return result;
+  };
+
+  const auto command = word();
+  if (command == "stats") {
+    const auto batches = counters.batches.load();
+    char response[256];
+    std::snprintf(response, sizeof(response),
+                  "ok queries %llu batches %llu mean_batch %.2f "
+                  "cache_probes %llu cache_hits %llu",
+                  counters.queries.load(), batches,
+                  batches == 0 ? 0.0
+                               : static_cast<double>(counters.queries) /
+                                     batches,
+                  counters.cache_probes.load(), counters.cache_hits.load());
+    return done(response);
+  }
+
+  if (command == "moves") {
+    query->kind = Kind::MOVES;
+  } else if (command == "state") {
+    query->kind = Kind::STATE;
+  } else if (command == "best") {
+    query->kind = Kind::BEST;
+    const auto limit = word();
+    const auto value = std::strtoull(std::string(word()).c_str(), nullptr, 10);
+    if (limit == "depth" && 1 <= value && value <= 64) {
+      query->limits.depth = static_cast<int>(value);
+    } else if (limit == "nodes" && value >= 1) {
+      query->limits.nodes = value;
+    } else {
+      return done("error expected depth <1-64> or nodes <count>");
+    }
+  } else {
+    return done("error unknown request");
+  }
+
+  const auto start = line.find_first_not_of(' ');
+  query->fen = start == std::string_view::npos ? "" : line.substr(start);
+  if (!Board::valid_fen(query->fen)) {
+    return done("error invalid fen");
+  }
+  return query;
+}
+
+struct Connection {
+  int fd = -1;
+  std::string input;
+  std::string output;
+  std::deque<std::shared_ptr<Query>> pending;
+  bool closing = false; // the client is gone or misbehaved
+};
+
+int listen_on(const Options &options) {
+  int fd = -1;
+  if (options.port != 0) {
+    fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    const int yes = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<std::uint16_t>(options.port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) !=
+        0) {
+      ::close(fd);
+      return -1;
+    }
+  } else {
+    fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (options.socket_path.size() >= sizeof(address.sun_path)) {
+      ::close(fd);
+      return -1;
+    }
+    std::strcpy(address.sun_path, options.socket_path.c_str());
+    ::unlink(options.socket_path.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) !=
+        0) {
+      ::close(fd);
+      return -1;
+    }
+  }
+  if (::listen(fd, SOMAXCONN) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  ::fcntl(fd, F_SETFL, O_NONBLOCK);
+  return fd;
+}
+
+bool parse_options(int argc, char **argv, Options &options) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const std::string_view arg = argv[i];
+    const char *value = argv[i + 1];
+    if (arg == "--socket") {
+      options.socket_path = value;
+    } else if (arg == "--port") {
+      options.port = std::atoi(value);
+    } else if (arg == "--threads") {
+      options.threads = std::max(1, std::atoi(value));
+    } else if (arg == "--batch") {
+      options.batch = std::max(1, std::atoi(value));
+    } else if (arg == "--cache") {
+      options.cache = std::max(1, std::atoi(value));
+    } else if (arg == "--analysis-cache") {
+      options.analysis_cache_path = value;
+    } else {
+      return false;
+    }
+  }
+  return argc % 2 == 1;
+}
+
+std::atomic<bool> stop_flag = false;
+
+void on_stop_signal(int) { stop_flag = true; }
+
+} // namespace
+
+int main(int argc, char **argv) {
+  SetTraceLogLevel(LOG_WARNING);
+
+  Options options;
+  if (!parse_options(argc, argv, options)) {
+    std::fprintf(stderr,
+                 "usage: %s [--socket <path> | --port <port>] "
+                 "[--threads <count>] [--batch <queries>] "
+                 "[--cache <entries>] [--analysis-cache <path>]\n",
+                 argv[0]);
+    return 2;
+  }
+
+  const int listen_fd = listen_on(options);
+  if (listen_fd == -1) {
+    std::perror("listen");
+    return 1;
+  }
+  std::signal(SIGPIPE, SIG_IGN);
+  std::signal(SIGINT, on_stop_signal);
+  std::signal(SIGTERM, on_stop_signal);
+  stats::install_report_signal();
+  if (options.port != 0) {
+    std::printf("listening on 127.0.0.1:%d\n", options.port);
+  } else {
+    std::printf("listening on %s\n", options.socket_path.c_str());
+  }
+  std::fflush(stdout);
+
+  std::unique_ptr<AnalysisCache> analysis;
+  if (!options.analysis_cache_path.empty()) {
+    analysis = AnalysisCache::open(options.analysis_cache_path,
+                                   Search::EVALUATION_VERSION);
+    if (analysis == nullptr) {
+      std::perror(options.analysis_cache_path.c_str());
+      return 1;
+    }
+    std::printf("analysis cache %s: %zu of %zu entries used\n",
+                options.analysis_cache_path.c_str(), analysis->occupied(),
+                analysis->capacity());
+  }
+
+  Shared shared(options.cache, analysis.get());
+  auto &counters = shared.counters;
+  BatchQueue queue;
+
+  std::vector<std::jthread> workers;
+  for (int i = 0; i < options.threads; ++i) {
+    workers.emplace_back([&](std::stop_token token) {
+      while (auto batch = queue.pop(token)) {
+        process(*batch, shared, token);
+      }
+    });
+  }
+
+  std::vector<std::unique_ptr<Connection>> connections;
+  std::vector<pollfd> fds;
+  while (!stop_flag) {
+    fds.clear();
+    fds.push_back({listen_fd, POLLIN, 0});
+    fds.push_back({shared.waker.fd(), POLLIN, 0});
+    for (const auto &connection : connections) {
+      // a hangup is reported even without events, and drops the connection
+      const short events = static_cast<short>(
+          (connection->closing ? 0 : POLLIN) |
+          (connection->output.empty() ? 0 : POLLOUT));
+      fds.push_back({connection->fd, events, 0});
+    }
+    if (::poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR) {
+      std::perror("poll");
+      break;
+    }
+    if (stats::report_requested()) {
+      std::puts(stats::report().c_str());
+    }
+
+    if ((fds[0].revents & POLLIN) != 0) {
+      for (int fd; (fd = ::accept(listen_fd, nullptr, nullptr)) != -1;) {
+        ::fcntl(fd, F_SETFL, O_NONBLOCK);
+        connections.push_back(std::make_unique<Connection>());
+        connections.back()->fd = fd;
+      }
+    }
+    if ((fds[1].revents & POLLIN) != 0) {
+      shared.waker.drain();
+    }
+
+    // the client is gone, its answers are thrown away and its searches
+    // stopped unless other clients wait for them too
+    const auto drop = [&](Connection &connection) {
+      for (const auto &query : connection.pending) {
+        shared.in_flight.cancel(*query);
+      }
+      connection.pending.clear();
+      connection.input.clear();
+      connection.output.clear();
+      connection.closing = true;
+    };
+
+    Batch states;
+    for (std::size_t i = 0; i + 2 < fds.size(); ++i) {
+      auto &connection = *connections[i];
+      const auto revents = fds[i + 2].revents;
+      if (!connection.closing &&
+          (revents & (POLLIN | POLLHUP | POLLERR)) != 0) {
+        char buffer[4096];
+        const auto size = ::read(connection.fd, buffer, sizeof(buffer));
+        if (size > 0) {
+          connection.input.append(buffer, size);
+        } else if (size == 0) {
+          // the client may still read the answers it is waiting for
+          connection.closing = true;
+        } else if (errno != EAGAIN) {
+          drop(connection);
+        }
+      }
+      if ((revents & (POLLHUP | POLLERR)) != 0) {
+        drop(connection);
+      }
+
+      std::size_t start = 0;
+      for (auto end = connection.input.find('\n'); end != std::string::npos;
+           start = end + 1, end = connection.input.find('\n', start)) {
+        std::string_view line(connection.input.data() + start, end - start);
+        if (!line.empty() && line.back() == '\r') {
+          line.remove_suffix(1);
+        }
+        if (line.empty()) {
+          continue;
+        }
+        auto query = parse_request(line, counters);
+        if (!query->done) {
+          ++counters.queries;
+          if (query->kind == Kind::STATE) {
+            states.push_back(query);
+          } else {
+            // searches are spread over the workers one by one
+            queue.push(Batch{query});
+            ++counters.batches;
+          }
+        }
+        connection.pending.push_back(std::move(query));
+      }
+      connection.input.erase(0, start);
+      if (connection.input.size() > max_line) {
+        connection.output += "error line too long\n";
+        connection.input.clear();
+        connection.closing = true;
+      }
+
+      // answers leave in request order
+      while (!connection.pending.empty() &&
+             connection.pending.front()->done.load(std::memory_order_acquire)) {
+        connection.output += connection.pending.front()->response;
+        connection.output += '\n';
+        connection.pending.pop_front();
+      }
+      if (!connection.output.empty()) {
+        const auto size = ::write(connection.fd, connection.output.data(),
+                                  connection.output.size());
+        if (size > 0) {
+          connection.output.erase(0, size);
+        } else if (size < 0 && errno != EAGAIN) {
+          drop(connection);
+        }
+      }
+    }
+
+    for (std::size_t start = 0; start < states.size();
+         start += options.batch) {
+      const auto end = std::min(states.size(), start + options.batch);
+      queue.push(Batch(states.begin() + start, states.begin() + end));
+      ++counters.batches;
+    }
+
+    std::erase_if(connections, [](const auto &connection) {
+      const bool finished = connection->closing &&
+                            connection->pending.empty() &&
+                            connection->output.empty();
+      if (finished) {
+        ::close(connection->fd);
+      }
+      return finished;
+    });
+  }
+
+  for (auto &worker : workers) {
+    worker.request_stop();
+  }
+  workers.clear();
+  for (const auto &connection : connections) {
+    ::close(connection->fd);
+  }
+  ::close(listen_fd);
+  if (options.port == 0) {
+    ::unlink(options.socket_path.c_str());
+  }
+  std::printf("%llu queries in %llu batches, %llu of %llu cache probes hit\n",
+              counters.queries.load(), counters.batches.load(),
+              counters.cache_hits.load(), counters.cache_probes.load());
+#ifdef CHESS_STATS
+  std::puts(stats::report().c_str());
+#endif
+}
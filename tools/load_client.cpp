@@ -0,0 +1,247 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Load generator for the analysis server. Every connection sends its
+// requests one after another, picking positions and request kinds at
+// random, and the latency of each request is measured from sending the
+// line to reading the answer. Prints throughput and latency percentiles.
+//
+// usage: load_client [--socket <path> | --port <port>]
+//                    [--connections <count>] [--queries <per connection>]
+//                    [--depth <plies>] [--mix <moves>:<state>:<best>]
+//                    [--fens <file>]
+
+namespace {
+
+struct Options {
+  std::string socket_path = "chess.sock";
+  int port = 0;
+  int connections = 16;
+  int queries = 1000;
+  int depth = 3;
+  // relative weights of the request kinds
+  std::array<int, 3> mix = {45, 45, 10};
+  std::string fens_path;
+};
+
+constexpr std::string_view default_fens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q2/PPPBBPpP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "rnbqkb1r/pp2pppp/3p1n2/8/3NP3/8/PPP2PPP/RNBQKB1R w KQkq - 1 5",
+    "r1bq1rk1/ppp2ppp/2np1n2/2b1p3/2B1P3/2NP1N2/PPP2PPP/R1BQ1RK1 w - - 0 7",
+    "8/8/1k6/8/2pP4/8/5K2/8 b - d3 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "4k3/8/8/8/8/8/8/4K2R w K - 0 1",
+};
+
+int connect_to(const Options &options) {
+  if (options.port != 0) {
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<std::uint16_t>(options.port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&address),
+                  sizeof(address)) != 0) {
+      ::close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, options.socket_path.c_str(),
+               sizeof(address.sun_path) - 1);
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) !=
+      0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+struct Outcome {
+  std::vector<long long> latencies_ns;
+  int errors = 0;
+  bool failed = false; // the connection broke down
+};
+
+void run_connection(const Options &options,
+                    const std::vector<std::string> &fens, unsigned seed,
+                    Outcome &outcome) {
+  const int fd = connect_to(options);
+  if (fd == -1) {
+    outcome.failed = true;
+    return;
+  }
+
+  std::mt19937 rng(seed);
+  std::discrete_distribution<int> kind(options.mix.begin(), options.mix.end());
+  std::string input;
+  char buffer[4096];
+  for (int i = 0; i < options.queries; ++i) {
+    const auto &fen = fens[rng() % fens.size()];
+    std::string request;
+    switch (kind(rng)) {
+    case 0:
+      request = "moves " + fen + '\n';
+      break;
+    case 1:
+      request = "state " + fen + '\n';
+      break;
+    default:
+      request =
+          "best depth " + std::to_string(options.depth) + ' ' + fen + '\n';
+      break;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    if (::write(fd, request.data(), request.size()) !=
+        static_cast<ssize_t>(request.size())) {
+      outcome.failed = true;
+      break;
+    }
+    auto end = input.find('\n');
+    while (end == std::string::npos) {
+      const auto size = ::read(fd, buffer, sizeof(buffer));
+      if (size <= 0) {
+        outcome.failed = true;
+        ::close(fd);
+        return;
+      }
+      input.append(buffer, size);
+      end = input.find('\n');
+    }
+    outcome.latencies_ns.push_back(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count());
+    outcome.errors += input.starts_with("error");
+    input.erase(0, end + 1);
+  }
+  ::close(fd);
+}
+
+bool parse_options(int argc, char **argv, Options &options) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const std::string_view arg = argv[i];
+    const char *value = argv[i + 1];
+    if (arg == "--socket") {
+      options.socket_path = value;
+    } else if (arg == "--port") {
+      options.port = std::atoi(value);
+    } else if (arg == "--connections") {
+      options.connections = std::max(1, std::atoi(value));
+    } else if (arg == "--queries") {
+      options.queries = std::max(1, std::atoi(value));
+    } else if (arg == "--depth") {
+      options.depth = std::max(1, std::atoi(value));
+    } else if (arg == "--mix") {
+      if (std::sscanf(value, "%d:%d:%d", &options.mix[0], &options.mix[1],
+                      &options.mix[2]) != 3 ||
+          std::ranges::any_of(options.mix, [](int w) { return w < 0; }) ||
+          options.mix[0] + options.mix[1] + options.mix[2] == 0) {
+        return false;
+      }
+    } else if (arg == "--fens") {
+      options.fens_path = value;
+    } else {
+      return false;
+    }
+  }
+  return argc % 2 == 1;
+}
+
+double percentile(const std::vector<long long> &sorted, double p) {
+  const auto index = static_cast<std::size_t>(p * (sorted.size() - 1) + 0.5);
+  return sorted[index] / 1e6;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parse_options(argc, argv, options)) {
+    std::fprintf(stderr,
+                 "usage: %s [--socket <path> | --port <port>] "
+                 "[--connections <count>] [--queries <per connection>] "
+                 "[--depth <plies>] [--mix <moves>:<state>:<best>] "
+                 "[--fens <file>]\n",
+                 argv[0]);
+    return 2;
+  }
+
+  std::vector<std::string> fens;
+  if (!options.fens_path.empty()) {
+    std::ifstream in(options.fens_path);
+    for (std::string line; std::getline(in, line);) {
+      if (!line.empty() && line[0] != '#') {
+        fens.push_back(line);
+      }
+    }
+  }
+  if (fens.empty()) {
+    fens.assign(std::begin(default_fens), std::end(default_fens));
+  }
+
+  std::vector<Outcome> outcomes(options.connections);
+  const auto start = std::chrono::steady_clock::now();
+  {
+    std::vector<std::jthread> threads;
+    for (int i = 0; i < options.connections; ++i) {
+      threads.emplace_back(run_connection, std::cref(options), std::cref(fens),
+                           i + 1, std::ref(outcomes[i]));
+    }
+  }
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  std::vector<long long> latencies;
+  int errors = 0, failed = 0;
+  for (const auto &outcome : outcomes) {
+    latencies.insert(latencies.end(), outcome.latencies_ns.begin(),
+                     outcome.latencies_ns.end());
+    errors += outcome.errors;
+    failed += outcome.failed;
+  }
+  if (latencies.empty()) {
+    std::fprintf(stderr, "no answers, is the server running?\n");
+    return 1;
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  std::printf("%zu queries over %d connections in %.2f s: %.0f queries/s\n",
+              latencies.size(), options.connections, seconds,
+              latencies.size() / seconds);
+  std::printf("latency p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+              percentile(latencies, 0.50), percentile(latencies, 0.99),
+              latencies.back() / 1e6);
+  if (errors != 0 || failed != 0) {
+    std::printf("%d error answers, %d connections failed\n", errors, failed);
+  }
+  return errors != 0 || failed != 0 ? 1 : 0;
+}
@@ -0,0 +1,231 @@
+#include "board.hpp"
+#include "mate.hpp"
+#include "notation.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Checks the forced mates of an EPD file with the proof-number solver. A
+// "dm <moves>" operation gives the length of the mate to prove, positions
+// without one are tried with --moves. Every puzzle is reported with its
+// status and time as it finishes, in the order they finish:
+//
+//   <id> solved <moves> <time> ms <nodes> nodes: <line in SAN>
+//   <id> unsolved <moves> <time> ms <nodes> nodes  (no such mate exists)
+//   <id> unknown <moves> <time> ms <nodes> nodes   (out of nodes or time)
+//
+// usage: mate_solver <epd file> [--moves <count>] [--memory <MiB>]
+//                    [--nodes <count>] [--time <ms>]
+//                    [--concurrency <threads>]
+//
+// Every thread has a node table of --memory MiB, kept from one puzzle to
+// the next.
+
+namespace {
+
+using namespace chess;
+
+struct Options {
+  std::string epd_path;
+  int moves = 3;
+  std::size_t memory_mib = 64;
+  unsigned long long nodes = 0;
+  int time_ms = 0;
+  int concurrency = static_cast<int>(
+      std::max(1u, std::thread::hardware_concurrency()));
+};
+
+struct Puzzle {
+  std::string id;
+  std::string fen;
+  std::optional<int> moves; // from the "dm" operation
+};
+
+// "<board> <side> <castling> <en passant> [<opcode> <operands>;]...", the
+// move counters are left out in EPD
+std::optional<Puzzle> parse_epd(std::string_view line) {
+  Puzzle puzzle;
+  std::size_t end = 0;
+  for (int field = 0; field < 4; ++field) {
+    const auto start = line.find_first_not_of(' ', end);
+    if (start == std::string_view::npos) {
+      return std::nullopt;
+    }
+    end = std::min(line.find(' ', start), line.size());
+    puzzle.fen += line.substr(start, end - start);
+    puzzle.fen += ' ';
+  }
+  puzzle.fen += "0 1";
+  if (!Board::valid_fen(puzzle.fen)) {
+    return std::nullopt;
+  }
+
+  auto operations = line.substr(end);
+  while (!operations.empty()) {
+    const auto semicolon = std::min(operations.find(';'), operations.size());
+    auto operation = operations.substr(0, semicolon);
+    operations.remove_prefix(std::min(semicolon + 1, operations.size()));
+    operation.remove_prefix(
+        std::min(operation.find_first_not_of(' '), operation.size()));
+    if (operation.starts_with("dm ")) {
+      puzzle.moves = std::atoi(std::string(operation.substr(3)).c_str());
+    } else if (operation.starts_with("id ")) {
+      auto id = operation.substr(3);
+      id.remove_prefix(std::min(id.find_first_not_of(" \""), id.size()));
+      id = id.substr(0, id.find('"'));
+      puzzle.id = id;
+    }
+  }
+  return puzzle;
+}
+
+bool parse_options(int argc, char **argv, Options &options) {
+  if (argc < 2 || argv[1][0] == '-') {
+    return false;
+  }
+  options.epd_path = argv[1];
+  for (int i = 2; i + 1 < argc; i += 2) {
+    const std::string_view arg = argv[i];
+    const char *value = argv[i + 1];
+    if (arg == "--moves") {
+      options.moves = std::max(1, std::atoi(value));
+    } else if (arg == "--memory") {
+      options.memory_mib = std::max(1, std::atoi(value));
+    } else if (arg == "--nodes") {
+      options.nodes = std::strtoull(value, nullptr, 10);
+    } else if (arg == "--time") {
+      options.time_ms = std::atoi(value);
+    } else if (arg == "--concurrency") {
+      options.concurrency = std::max(1, std::atoi(value));
+    } else {
+      return false;
+    }
+  }
+  return argc % 2 == 0;
+}
+
+std::string san_line(Board &board, const std::vector<Move> &line) {
+  std::string result;
+  for (const auto move : line) {
+    if (!result.empty()) {
+      result += ' ';
+    }
+    result += to_san(board, move);
+    board.make_move(move.from, move.to);
+  }
+  for (std::size_t i = 0; i < line.size(); ++i) {
+    board.unmake_move();
+  }
+  return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  SetTraceLogLevel(LOG_WARNING);
+
+  Options options;
+  if (!parse_options(argc, argv, options)) {
+    std::fprintf(stderr,
+                 "usage: %s <epd file> [--moves <count>] [--memory <MiB>] "
+                 "[--nodes <count>] [--time <ms>] "
+                 "[--concurrency <threads>]\n",
+                 argv[0]);
+    return 2;
+  }
+
+  std::ifstream in(options.epd_path);
+  if (!in) {
+    std::perror(options.epd_path.c_str());
+    return 1;
+  }
+  std::vector<Puzzle> puzzles;
+  int invalid = 0;
+  int line_number = 0;
+  for (std::string line; std::getline(in, line);) {
+    ++line_number;
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    auto puzzle = parse_epd(line);
+    if (!puzzle) {
+      std::fprintf(stderr, "line %d: not a valid position\n", line_number);
+      ++invalid;
+      continue;
+    }
+    if (puzzle->id.empty()) {
+      puzzle->id = "line " + std::to_string(line_number);
+    }
+    puzzles.push_back(std::move(*puzzle));
+  }
+
+  std::mutex mutex;
+  std::atomic<int> next_puzzle = 0;
+  std::array<int, 3> counts = {0, 0, 0}; // by MateResult::Status
+  const auto start = std::chrono::steady_clock::now();
+
+  const auto worker = [&]() {
+    MateSearch search(MateLimits{.memory_bytes = options.memory_mib << 20,
+                                 .nodes = options.nodes,
+                                 .time_ms = options.time_ms});
+
+    for (int i = next_puzzle++; i < static_cast<int>(puzzles.size());
+         i = next_puzzle++) {
+      const auto &puzzle = puzzles[i];
+      const int moves = puzzle.moves.value_or(options.moves);
+      Board board(puzzle.fen);
+      // drop what the previous puzzle left in this thread's history
+      board.history() = {};
+      board.history().push(board);
+
+      const auto puzzle_start = std::chrono::steady_clock::now();
+      const auto result = search.run(board, moves);
+      const double ms = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - puzzle_start)
+                            .count();
+
+      std::lock_guard lock(mutex);
+      ++counts[static_cast<int>(result.status)];
+      switch (result.status) {
+      case MateResult::Status::PROVEN:
+        std::printf("%s solved %d %.1f ms %llu nodes: %s\n", puzzle.id.c_str(),
+                    result.moves, ms, result.nodes,
+                    san_line(board, result.line).c_str());
+        break;
+      case MateResult::Status::DISPROVEN:
+        std::printf("%s unsolved %d %.1f ms %llu nodes\n", puzzle.id.c_str(),
+                    moves, ms, result.nodes);
+        break;
+      case MateResult::Status::UNKNOWN:
+        std::printf("%s unknown %d %.1f ms %llu nodes\n", puzzle.id.c_str(),
+                    moves, ms, result.nodes);
+        break;
+      }
+      std::fflush(stdout);
+    }
+  };
+
+  {
+    std::vector<std::jthread> threads;
+    for (int i = 0; i < options.concurrency; ++i) {
+      threads.emplace_back(worker);
+    }
+  }
+
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+  std::printf("%d solved, %d unsolved, %d unknown, %d invalid in %.2f s\n",
+              counts[0], counts[1], counts[2], invalid, seconds);
+  return counts[1] != 0 || counts[2] != 0 || invalid != 0 ? 1 : 0;
+}
@@ -0,0 +1,409 @@
+#include "board.hpp"
+#include "notation.hpp"
+#include "search.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Headless self-play between two search configurations, A and B, on a pool
+// of threads. Every pair of games starts from the next opening followed by
+// --random-plies random moves and is played twice with colors swapped, as
+// searches limited by nodes or depth would otherwise replay the same game
+// for every pair of an opening. Finished games are appended to a PGN file,
+// and the run stops as soon as the sequential probability ratio test
+// accepts either hypothesis H0: elo = elo0 or H1: elo = elo1 (elo of A
+// relative to B). Without random plies no more than two games per opening
+// are played.
+//
+// usage: tournament [--openings <file>] [--pgn <file>] [--games <count>]
+//                   [--random-plies <count>] [--seed <number>]
+//                   [--concurrency <threads>] [--max-plies <count>]
+//                   [--nodes[-a|-b] <count>] [--movetime[-a|-b] <ms>]
+//                   [--depth[-a|-b] <plies>]
+//                   [--elo0 <elo>] [--elo1 <elo>] [--alpha <p>] [--beta <p>]
+
+namespace {
+
+using namespace chess;
+
+constexpr std::string_view start_fen =
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+struct Options {
+  std::string openings_path;
+  std::string pgn_path = "tournament.pgn";
+  int games = 1000;
+  int random_plies = 8;
+  std::uint64_t seed = 1;
+  int concurrency = static_cast<int>(
+      std::max(1u, std::thread::hardware_concurrency()));
+  int max_plies = 400;
+  std::array<SearchLimits, 2> engines = {SearchLimits{.nodes = 2000},
+                                         SearchLimits{.nodes = 2000}};
+  double elo0 = 0;
+  double elo1 = 10;
+  double alpha = 0.05;
+  double beta = 0.05;
+};
+
+enum class Outcome { WHITE_WINS, BLACK_WINS, DRAW, ABORTED };
+
+struct GameRecord {
+  int round = 0;
+  std::string fen;
+  bool a_is_white = true;
+  std::vector<std::string> moves;
+  Outcome outcome = Outcome::ABORTED;
+  std::string termination;
+};
+
+GameRecord play_game(int round, const std::string &fen, bool a_is_white,
+                     const Options &options, std::stop_token token) {
+  GameRecord record;
+  record.round = round;
+  record.fen = fen;
+  record.a_is_white = a_is_white;
+
+  Board board(fen);
+  // drop what the previous game left in this thread's history
+  board.history() = {};
+  board.history().push(board);
+
+  std::array<Search, 2> engines = {Search(options.engines[0]),
+                                   Search(options.engines[1])};
+  for (int ply = 0;; ++ply) {
+    const auto state = board.game_state();
+    if (state == Board::State::MATE) {
+      record.outcome = board.turn() == pieces::WHITE ? Outcome::BLACK_WINS
+                                                     : Outcome::WHITE_WINS;
+      record.termination = "checkmate";
+      break;
+    }
+    if (state == Board::State::DRAW) {
+      record.outcome = Outcome::DRAW;
+      record.termination = board.has_legal_move()
+                               ? "fifty-move rule or threefold repetition"
+                               : "stalemate";
+      break;
+    }
+    if (ply >= options.max_plies) {
+      record.outcome = Outcome::DRAW;
+      record.termination = "adjudicated after " +
+                           std::to_string(options.max_plies) + " plies";
+      break;
+    }
+
+    const bool white_to_move = board.turn() == pieces::WHITE;
+    auto &engine = engines[white_to_move == a_is_white ? 0 : 1];
+    const auto result = engine.run(board, token);
+    if (token.stop_requested()) {
+      record.outcome = Outcome::ABORTED;
+      break;
+    }
+    record.moves.push_back(to_san(board, result.best_move));
+    board.make_move(result.best_move.from, result.best_move.to);
+  }
+  return record;
+}
+
+// The opening after `plies` random moves, the same for the same seed. Walks
+// that end the game are tried again.
+std::string random_opening(const std::string &fen, int plies,
+                           std::uint64_t seed) {
+  std::mt19937_64 random(seed);
+  for (int attempt = 0; attempt < 100; ++attempt) {
+    Board board(fen);
+    board.history() = {};
+    board.history().push(board);
+    for (int ply = 0; ply < plies && board.has_legal_move(); ++ply) {
+      const auto &moves = board.legal_moves();
+      const auto move = moves[static_cast<int>(random() % moves.size())];
+      board.make_move(move.from, move.to);
+    }
+    if (board.game_state() == Board::State::PLAYING) {
+      return board.to_fen();
+    }
+  }
+  return fen;
+}
+
+std::string to_pgn(const GameRecord &record) {
+  const char *result = record.outcome == Outcome::WHITE_WINS   ? "1-0"
+                       : record.outcome == Outcome::BLACK_WINS ? "0-1"
+                                                               : "1/2-1/2";
+
+  // the move counters are the last two fields of the FEN
+  const auto counters = record.fen.find_last_of(' ');
+  int move_number = std::max(1, std::atoi(record.fen.c_str() + counters + 1));
+  bool white_to_move = record.fen.find(" b ") == std::string::npos;
+
+  std::string pgn;
+  pgn += "[Event \"self-play\"]\n";
+  pgn += "[Site \"local\"]\n";
+  pgn += "[Round \"" + std::to_string(record.round) + "\"]\n";
+  pgn += std::string("[White \"") + (record.a_is_white ? "A" : "B") + "\"]\n";
+  pgn += std::string("[Black \"") + (record.a_is_white ? "B" : "A") + "\"]\n";
+  pgn += std::string("[Result \"") + result + "\"]\n";
+  if (record.fen != start_fen) {
+    pgn += "[SetUp \"1\"]\n";
+    pgn += "[FEN \"" + record.fen + "\"]\n";
+  }
+  pgn += "[Termination \"" + record.termination + "\"]\n\n";
+
+  for (std::size_t i = 0; i < record.moves.size(); ++i) {
+    if (white_to_move) {
+      pgn += std::to_string(move_number) + ". ";
+    } else if (i == 0) {
+      pgn += std::to_string(move_number) + "... ";
+    }
+    pgn += record.moves[i] + ' ';
+    if (!white_to_move) {
+      ++move_number;
+    }
+    white_to_move = !white_to_move;
+  }
+  pgn += result;
+  pgn += "\n\n";
+  return pgn;
+}
+
+double expected_score(double elo) {
+  return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+}
+
+double score_to_elo(double score) {
+  score = std::clamp(score, 1e-6, 1 - 1e-6);
+  return -400.0 * std::log10(1.0 / score - 1.0);
+}
+
+struct Statistics {
+  int wins = 0; // from A's point of view
+  int draws = 0;
+  int losses = 0;
+
+  int games() const { return wins + draws + losses; }
+  double score() const { return (wins + draws / 2.0) / games(); }
+
+  double variance() const {
+    const double s = score();
+    return (wins * (1 - s) * (1 - s) + draws * (0.5 - s) * (0.5 - s) +
+            losses * s * s) /
+           games();
+  }
+
+  // Log-likelihood ratio of H1 against H0 in the normal approximation of
+  // the generalized SPRT over game results.
+  double llr(double elo0, double elo1) const {
+    const double var = variance();
+    if (games() == 0 || var <= 0) {
+      return 0;
+    }
+    const double s0 = expected_score(elo0);
+    const double s1 = expected_score(elo1);
+    return (s1 - s0) * (2 * score() - s0 - s1) * games() / (2 * var);
+  }
+
+  // 95% confidence interval half-width in elo
+  double elo_error() const {
+    const double margin = 1.96 * std::sqrt(variance() / games());
+    return (score_to_elo(score() + margin) - score_to_elo(score() - margin)) /
+           2;
+  }
+};
+
+// nullopt when a line is not a valid FEN
+std::optional<std::vector<std::string>>
+read_openings(const std::string &path) {
+  std::vector<std::string> openings;
+  if (!path.empty()) {
+    std::ifstream in(path);
+    int line_number = 0;
+    for (std::string line; std::getline(in, line);) {
+      ++line_number;
+      // one FEN per line, '#' starts a comment line
+      if (line.empty() || line[0] == '#') {
+        continue;
+      }
+      if (!Board::valid_fen(line)) {
+        std::fprintf(stderr, "%s:%d: not a valid position\n", path.c_str(),
+                     line_number);
+        return std::nullopt;
+      }
+      openings.push_back(line);
+    }
+  }
+  if (openings.empty()) {
+    openings.emplace_back(start_fen);
+  }
+  return openings;
+}
+
+bool parse_options(int argc, char **argv, Options &options) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const std::string_view arg = argv[i];
+    const char *value = argv[i + 1];
+
+    // "--nodes" sets both engines, "--nodes-a" and "--nodes-b" one of them
+    const auto engine_option = [&](std::string_view name, auto setter) {
+      if (arg == name) {
+        setter(options.engines[0]);
+        setter(options.engines[1]);
+      } else if (arg.starts_with(name) && arg.size() == name.size() + 2 &&
+                 arg[name.size()] == '-' &&
+                 (arg.back() == 'a' || arg.back() == 'b')) {
+        setter(options.engines[arg.back() - 'a']);
+      } else {
+        return false;
+      }
+      return true;
+    };
+
+    if (engine_option("--nodes", [&](SearchLimits &limits) {
+          limits.nodes = std::strtoull(value, nullptr, 10);
+        }) ||
+        engine_option("--movetime", [&](SearchLimits &limits) {
+          limits.time_ms = std::atoi(value);
+        }) ||
+        engine_option("--depth", [&](SearchLimits &limits) {
+          limits.depth = std::atoi(value);
+        })) {
+      continue;
+    }
+
+    if (arg == "--openings") {
+      options.openings_path = value;
+    } else if (arg == "--pgn") {
+      options.pgn_path = value;
+    } else if (arg == "--games") {
+      options.games = std::atoi(value);
+    } else if (arg == "--random-plies") {
+      options.random_plies = std::max(0, std::atoi(value));
+    } else if (arg == "--seed") {
+      options.seed = std::strtoull(value, nullptr, 10);
+    } else if (arg == "--concurrency") {
+      options.concurrency = std::max(1, std::atoi(value));
+    } else if (arg == "--max-plies") {
+      options.max_plies = std::atoi(value);
+    } else if (arg == "--elo0") {
+      options.elo0 = std::atof(value);
+    } else if (arg == "--elo1") {
+      options.elo1 = std::atof(value);
+    } else if (arg == "--alpha") {
+      options.alpha = std::atof(value);
+    } else if (arg == "--beta") {
+      options.beta = std::atof(value);
+    } else {
+      return false;
+    }
+  }
+  return argc % 2 == 1;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  SetTraceLogLevel(LOG_WARNING);
+
+  Options options;
+  if (!parse_options(argc, argv, options)) {
+    std::fprintf(stderr,
+                 "usage: %s [--openings <file>] [--pgn <file>] "
+                 "[--games <count>] [--random-plies <count>] "
+                 "[--seed <number>] [--concurrency <threads>] "
+                 "[--max-plies <count>] [--nodes[-a|-b] <count>] "
+                 "[--movetime[-a|-b] <ms>] [--depth[-a|-b] <plies>] "
+                 "[--elo0 <elo>] [--elo1 <elo>] [--alpha <p>] [--beta <p>]\n",
+                 argv[0]);
+    return 2;
+  }
+
+  const auto openings = read_openings(options.openings_path);
+  if (!openings) {
+    return 1;
+  }
+  // without random plies every further pair would repeat an earlier one
+  const int distinct_games = 2 * static_cast<int>(openings->size());
+  if (options.random_plies == 0 && options.games > distinct_games) {
+    std::printf("playing %d games, two per opening\n", distinct_games);
+    options.games = distinct_games;
+  }
+  std::ofstream pgn(options.pgn_path);
+
+  const double lower_bound = std::log(options.beta / (1 - options.alpha));
+  const double upper_bound = std::log((1 - options.beta) / options.alpha);
+
+  std::mutex mutex;
+  Statistics statistics;
+  double llr = 0;
+  std::atomic<int> next_game = 0;
+  std::stop_source stop;
+
+  const auto worker = [&]() {
+    for (int game = next_game++; game < options.games && !stop.stop_requested();
+         game = next_game++) {
+      const int pair = game / 2;
+      const auto fen =
+          random_opening((*openings)[pair % openings->size()],
+                         options.random_plies, options.seed + pair);
+      const auto record =
+          play_game(game + 1, fen, game % 2 == 0, options, stop.get_token());
+      if (record.outcome == Outcome::ABORTED) {
+        break;
+      }
+
+      std::lock_guard lock(mutex);
+      const bool a_won = record.outcome == (record.a_is_white
+                                                ? Outcome::WHITE_WINS
+                                                : Outcome::BLACK_WINS);
+      const bool a_lost = record.outcome == (record.a_is_white
+                                                 ? Outcome::BLACK_WINS
+                                                 : Outcome::WHITE_WINS);
+      statistics.wins += a_won;
+      statistics.losses += a_lost;
+      statistics.draws += !a_won && !a_lost;
+
+      pgn << to_pgn(record) << std::flush;
+
+      llr = statistics.llr(options.elo0, options.elo1);
+      std::printf("game %d: +%d =%d -%d, elo %.1f +- %.1f, llr %.2f "
+                  "(%.2f, %.2f)\n",
+                  record.round, statistics.wins, statistics.draws,
+                  statistics.losses, score_to_elo(statistics.score()),
+                  statistics.elo_error(), llr, lower_bound, upper_bound);
+      std::fflush(stdout);
+
+      if (llr <= lower_bound || llr >= upper_bound) {
+        stop.request_stop();
+      }
+    }
+  };
+
+  {
+    std::vector<std::jthread> pool;
+    for (int i = 0; i < options.concurrency; ++i) {
+      pool.emplace_back(worker);
+    }
+  }
+
+  if (statistics.games() == 0) {
+    std::printf("no games played\n");
+    return 1;
+  }
+  std::printf("%d games, elo of A: %.1f +- %.1f, llr %.2f: %s\n",
+              statistics.games(), score_to_elo(statistics.score()),
+              statistics.elo_error(), llr,
+              llr >= upper_bound   ? "H1 accepted"
+              : llr <= lower_bound ? "H0 accepted"
+                                   : "inconclusive");
+}